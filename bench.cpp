@@ -0,0 +1,266 @@
+//
+// Stage benchmarks: times each stage of the converters on its own, on a map file or a synthetic map, with
+// warmup runs and repeats, and prints min / median / mean / stddev / max per stage.
+//
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <array>
+#include <chrono>
+#include <sstream>
+#include <fstream>
+#include <iostream>
+#include <filesystem>
+#include <unistd.h>
+#include "mesh2merged.h"
+#include "grid2poly.h"
+#include "poly2mesh.h"
+#include "grid2rect.h"
+#include "stats.h"
+#include "loadmap.h"
+#include "mapgen.h"
+
+std::string mapfile;
+std::vector<bool> mapData;
+int width, height;
+int warmup = 1;
+int repeats = 5;
+std::vector<std::string> selected; // stage name prefixes; empty runs every stage
+bool printJson = false;
+
+struct Summary {
+    std::string name;
+    std::vector<double> ms;
+};
+std::vector<Summary> results;
+
+bool parse_argv(int argc, char **argv) {
+    if (argc < 2) return false;
+    mapfile = std::string(argv[1]);
+
+    for (int i = 2; i < argc; i++) {
+        std::string option(argv[i]);
+        if (option.rfind("--warmup=", 0) == 0) warmup = std::atoi(option.c_str() + 9);
+        else if (option.rfind("--repeats=", 0) == 0) repeats = std::atoi(option.c_str() + 10);
+        else if (option.rfind("--stages=", 0) == 0) {
+            std::stringstream list(option.substr(9));
+            std::string name;
+            while (std::getline(list, name, ',')) {
+                if (!name.empty()) selected.push_back(name);
+            }
+        }
+        else if (option == "--json") printJson = true;
+        else if (option.rfind("--threads=", 0) == 0) poly2mesh::num_threads = mesh2merged::num_threads = std::atoi(option.c_str() + 10);
+        else if (option.rfind("--strips=", 0) == 0) poly2mesh::strips = std::atoi(option.c_str() + 9);
+        else if (option == "--cdt=library") poly2mesh::triangulator = poly2mesh::LIBRARY;
+        else if (option == "--cdt=rectilinear") poly2mesh::triangulator = poly2mesh::RECTILINEAR;
+        else if (option == "--merge=smart") mesh2merged::merge_strategy = mesh2merged::SMART;
+        else if (option == "--merge=matching") mesh2merged::merge_strategy = mesh2merged::MATCHING;
+        else if (option == "--merge-priority=area") mesh2merged::merge_priority = mesh2merged::AREA;
+        else if (option == "--merge-priority=search") mesh2merged::merge_priority = mesh2merged::SEARCH_COST;
+        else return false;
+    }
+
+    return repeats >= 1 && warmup >= 0;
+}
+
+void print_help(char **argv) {
+    std::printf("Invalid Arguments\nUsage %s <map> [options]\n", argv[0]);
+    std::printf("\t<map> : a .map file, or KIND:WxH[:DENSITY[:SEED]] for a synthetic map as mapgen makes it (noise, maze, rooms, stairs, open, corridors)\n");
+    std::printf("Options:\n");
+    std::printf("\t--warmup=N : Untimed runs of each stage before the timed ones (default: 1)\n");
+    std::printf("\t--repeats=N : Timed runs of each stage (default: 5)\n");
+    std::printf("\t--stages=A,B,... : Only time the stages whose names start with one of these, e.g. poly,merge.merge (default: all)\n");
+    std::printf("\t--json : Print the results as one JSON line instead of a table\n");
+    std::printf("\t--threads=N, --strips=N, --cdt=library|rectilinear, --merge=smart|matching, --merge-priority=area|search : As for run\n");
+}
+
+bool is_selected(const std::string& name) {
+    if (selected.empty()) return true;
+    for (const auto& prefix : selected) {
+        if (name.rfind(prefix, 0) == 0) return true;
+    }
+    return false;
+}
+
+// Is any stage of this group ("poly", "cdt", ...) selected?
+bool group_selected(const std::string& group) {
+    if (selected.empty()) return true;
+    for (const auto& prefix : selected) {
+        if (prefix.rfind(group, 0) == 0 || group.rfind(prefix, 0) == 0) return true;
+    }
+    return false;
+}
+
+// Run setup then run, warmup + repeats times, timing only run. A stage that is not selected still runs once,
+// untimed, since later stages start from what it leaves behind.
+void bench(const std::string& name, const std::function<void()>& run, const std::function<void()>& setup = nullptr) {
+    if (!is_selected(name)) {
+        if (setup) setup();
+        run();
+        return;
+    }
+    Summary summary{name, {}};
+    for (int i = 0; i < warmup + repeats; i++) {
+        if (setup) setup();
+        const auto start = std::chrono::steady_clock::now();
+        run();
+        const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        if (i >= warmup) summary.ms.push_back(ms);
+    }
+    results.push_back(summary);
+}
+
+struct Statistics {
+    double min, median, mean, stddev, max;
+};
+
+Statistics summarise(std::vector<double> ms) {
+    std::sort(ms.begin(), ms.end());
+    const size_t n = ms.size();
+    Statistics s;
+    s.min = ms.front();
+    s.max = ms.back();
+    s.median = n % 2 ? ms[n / 2] : (ms[n / 2 - 1] + ms[n / 2]) / 2;
+    s.mean = 0;
+    for (double t : ms) s.mean += t;
+    s.mean /= n;
+    // sample standard deviation; 0 for a single run
+    s.stddev = 0;
+    for (double t : ms) s.stddev += (t - s.mean) * (t - s.mean);
+    s.stddev = n > 1 ? std::sqrt(s.stddev / (n - 1)) : 0;
+    return s;
+}
+
+void print_table() {
+    std::printf("%s: %d x %d, %d warmup, %d repeats (ms)\n", mapfile.c_str(), width, height, warmup, repeats);
+    std::printf("%-18s %10s %10s %10s %10s %10s\n", "stage", "min", "median", "mean", "stddev", "max");
+    for (const auto& r : results) {
+        const Statistics s = summarise(r.ms);
+        std::printf("%-18s %10.3f %10.3f %10.3f %10.3f %10.3f\n", r.name.c_str(), s.min, s.median, s.mean, s.stddev, s.max);
+    }
+}
+
+// {"map": ..., "width", "height", "warmup", "repeats", "stages": [{"name", "min_ms", "median_ms", "mean_ms",
+//  "stddev_ms", "max_ms"}...]} on one line
+void print_json() {
+    std::cout << "{\"map\": ";
+    stats::write_string(std::cout, mapfile);
+    std::cout << ", \"width\": " << width << ", \"height\": " << height << ", \"warmup\": " << warmup
+              << ", \"repeats\": " << repeats << ", \"stages\": [";
+    char line[256];
+    for (size_t i = 0; i < results.size(); i++) {
+        const Statistics s = summarise(results[i].ms);
+        std::cout << (i == 0 ? "" : ", ") << "{\"name\": ";
+        stats::write_string(std::cout, results[i].name);
+        std::snprintf(line, sizeof line,
+                      ", \"min_ms\": %.4f, \"median_ms\": %.4f, \"mean_ms\": %.4f, \"stddev_ms\": %.4f, \"max_ms\": %.4f}",
+                      s.min, s.median, s.mean, s.stddev, s.max);
+        std::cout << line;
+    }
+    std::cout << "]}" << std::endl;
+}
+
+int main(int argc, char **argv)
+{
+    if (!parse_argv(argc, argv)) {
+        print_help(argv);
+        std::exit(1);
+    }
+
+    mapgen::Spec spec;
+    if (mapgen::parse_spec(mapfile, spec)) {
+        mapgen::generate(spec, mapData);
+        width = spec.width;
+        height = spec.height;
+    } else {
+        bench("load", [&]() { LoadMap(mapfile.c_str(), mapData, width, height); });
+        if (mapData.empty()) {
+            std::cerr << "Error opening " << mapfile << std::endl;
+            return 1;
+        }
+    }
+
+    // the meshes in between stages go to scratch files, as they would for run
+    const std::string scratch = (std::filesystem::temp_directory_path() /
+                                 ("startkit-bench-" + std::to_string(getpid()))).string();
+    const std::string polyfile = scratch + ".poly", cdtfile = scratch + ".cdt", mergedfile = scratch + ".merged-cdt";
+
+    const bool merge = group_selected("merge");
+    const bool cdt = merge || group_selected("cdt");
+    const bool poly = cdt || group_selected("poly");
+
+    if (poly) {
+        grid2poly::set_map(mapData, width, height);
+        bench("poly.flood_fill", grid2poly::get_id_and_elevation);
+        bench("poly.make_edges", grid2poly::make_edges);
+        bench("poly.trace", grid2poly::generate_polygons);
+        bench("poly.write", [&]() { grid2poly::output_polymap(polyfile); });
+        if (is_selected("poly.constraints")) {
+            grid2poly::vpoint vertices;
+            std::vector<std::array<int, 3>> segments;
+            bench("poly.constraints", [&]() { grid2poly::make_constraints(vertices, segments); });
+        }
+    }
+
+    if (cdt) {
+        std::unique_ptr<std::vector<poly2mesh::CustomPoly>> polygons;
+        std::vector<poly2mesh::CustomPoint2D> vertices;
+        std::vector<poly2mesh::Component> components;
+        CDT::TriangleVec triangles;
+        std::vector<std::vector<int>> fans;
+        bench("cdt.read_poly", [&]() {
+            std::ifstream fin(polyfile);
+            polygons.reset(poly2mesh::read_polys(fin));
+        });
+        bench("cdt.weld", [&]() { vertices = poly2mesh::weld_vertices(*polygons); });
+        bench("cdt.components", [&]() { components = poly2mesh::find_components(*polygons); });
+        bench("cdt.triangulate", [&]() { triangles = poly2mesh::triangulate_components(components, vertices); });
+        bench("cdt.fans", [&]() { fans = poly2mesh::build_vertex_fans(triangles, vertices); });
+        bench("cdt.write", [&]() {
+            std::ofstream fout(cdtfile);
+            poly2mesh::print_mesh(fout, vertices, triangles, fans);
+        });
+    }
+
+    if (merge) {
+        // every merge stage starts from a fresh copy of the CDT
+        auto read = [&]() {
+            mesh2merged::delete_nodes();
+            std::ifstream fin(cdtfile);
+            mesh2merged::read_mesh(fin);
+            mesh2merged::start_merge_budget();
+        };
+        bench("merge.read", read);
+        bench("merge.dead_ends", mesh2merged::merge_deadend, read);
+        bench("merge.merge", mesh2merged::merge_polygons, [&]() {
+            read();
+            mesh2merged::merge_deadend();
+        });
+        bench("merge.write", [&]() {
+            std::ofstream fout(mergedfile);
+            mesh2merged::print_mesh(fout);
+        });
+        mesh2merged::delete_nodes();
+    }
+
+    if (group_selected("rec")) {
+        bench("rec.rectangles", grid2rect::make_rectangles, [&]() { grid2rect::set_map(mapData, width, height); });
+    }
+
+    std::remove(polyfile.c_str());
+    std::remove(cdtfile.c_str());
+    std::remove(mergedfile.c_str());
+
+    if (printJson) {
+        print_json();
+    } else {
+        print_table();
+    }
+    return 0;
+}
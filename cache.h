@@ -0,0 +1,336 @@
+//
+// A content-addressed cache of converted meshes for --cache=DIR. The key hashes the loaded grid together
+// with the converter binary, the mesh type and the options that change the output, so a map that was
+// converted before is copied from the cache instead of converted again. Entries are evicted least recently
+// used first to keep the cache under a size bound.
+//
+// DIR/<key>/ holds one file per output mesh, named by its extension ("rec", "cdt", "merged-cdt"), and
+// "meta" with their sizes; the modification time of "meta" is when the entry was last used. DIR/totals
+// keeps the hit, miss, store and eviction counts over all runs.
+//
+
+#ifndef STARTKIT_CACHE_H
+#define STARTKIT_CACHE_H
+#include <string>
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <fstream>
+#include <filesystem>
+#include <system_error>
+#include <cstdio>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <linux/fs.h>
+#endif
+
+namespace meshcache {
+    namespace fs = std::filesystem;
+    using std::string;
+    using std::vector;
+
+    // part of every key; change it when the entry layout changes
+    const char* const LAYOUT = "startkit mesh cache 1";
+    long long max_bytes = 1LL << 30;
+    // hardlink meshes into and out of the cache instead of copying them (--cache-hardlink): no second copy on
+    // disk, but a tool that edits a delivered mesh in place then changes the cached one as well
+    bool hardlink = false;
+
+    __extension__ typedef unsigned __int128 uint128;
+
+    // FNV-1a with a 128-bit state, so two different maps in one cache never share a key by accident.
+    class Hasher {
+    public:
+        void add(const void* data, size_t size) {
+            auto bytes = (const unsigned char*)data;
+            for(size_t i = 0; i < size; i++){
+                h = (h ^ bytes[i]) * prime;
+            }
+        }
+        void add(const string& s) {
+            add_int(s.size());
+            add(s.data(), s.size());
+        }
+        void add_int(long long value) {
+            add(&value, sizeof value);
+        }
+        string hex() const {
+            char text[33];
+            std::snprintf(text, sizeof text, "%016llx%016llx", (unsigned long long)(h >> 64),
+                          (unsigned long long)h);
+            return text;
+        }
+
+    private:
+        static constexpr uint128 prime = ((uint128)0x0000000001000000ULL << 64) | 0x000000000000013BULL;
+        uint128 h = ((uint128)0x6c62272e07bb0142ULL << 64) | 0x62b821756295c58dULL;
+    };
+
+    // The running binary stands in for the converter version: any rebuild that could change a mesh
+    // changes the key.
+    const string& converter_hash() {
+        static const string hash = [] {
+            Hasher h;
+            std::ifstream exe("/proc/self/exe", std::ios::binary);
+            char buffer[1 << 16];
+            bool read = false;
+            while(exe.read(buffer, sizeof buffer) || exe.gcount() > 0){
+                h.add(buffer, exe.gcount());
+                read = true;
+            }
+            if(!read){
+                h.add(string(__DATE__ " " __TIME__));
+            }
+            return h.hex();
+        }();
+        return hash;
+    }
+
+    // map[y * width + x] is true for traversable cells; the grid goes into the hash eight cells a byte.
+    string key(const string& mode, const string& options, const vector<bool>& map, int width, int height) {
+        Hasher h;
+        h.add(string(LAYOUT));
+        h.add(converter_hash());
+        h.add(mode);
+        h.add(options);
+        h.add_int(width);
+        h.add_int(height);
+        vector<unsigned char> packed;
+        packed.reserve(1 << 16);
+        for(size_t i = 0; i < map.size(); i += 8){
+            unsigned char byte = 0;
+            for(size_t j = i; j < std::min(i + 8, map.size()); j++){
+                byte |= map[j] << (j - i);
+            }
+            packed.push_back(byte);
+            if(packed.size() == packed.capacity()){
+                h.add(packed.data(), packed.size());
+                packed.clear();
+            }
+        }
+        h.add(packed.data(), packed.size());
+        return h.hex();
+    }
+
+    string extension(const string& path) {
+        return fs::path(path).extension().string().substr(1);
+    }
+
+    // Over all runs that used the cache directory.
+    struct Totals {
+        long long hits = 0, misses = 0, stores = 0, evictions = 0, evicted_bytes = 0;
+    };
+
+    // Holds an exclusive lock on DIR/lock, so runs sharing a cache update the totals and evict one at a time.
+    class Lock {
+    public:
+        explicit Lock(const string& dir) : fd(open((fs::path(dir) / "lock").c_str(), O_RDWR | O_CREAT, 0644)) {
+            if(fd >= 0){
+                flock(fd, LOCK_EX);
+            }
+        }
+        ~Lock() {
+            if(fd >= 0){
+                close(fd);
+            }
+        }
+        Lock(const Lock&) = delete;
+        Lock& operator=(const Lock&) = delete;
+
+    private:
+        int fd;
+    };
+
+    Totals read_totals(const string& dir) {
+        Totals t;
+        std::ifstream in(fs::path(dir) / "totals");
+        in >> t.hits >> t.misses >> t.stores >> t.evictions >> t.evicted_bytes;
+        return t;
+    }
+
+    void write_totals(const string& dir, const Totals& t) {
+        std::ofstream out(fs::path(dir) / "totals");
+        out << t.hits << ' ' << t.misses << ' ' << t.stores << ' ' << t.evictions << ' ' << t.evicted_bytes << '\n';
+    }
+
+    template<typename Update>
+    void update_totals(const string& dir, Update update) {
+        Lock lock(dir);
+        Totals t = read_totals(dir);
+        update(t);
+        write_totals(dir, t);
+    }
+
+    // Replace to with a copy of from, or a hardlink with --cache-hardlink. Where the file system can, the copy
+    // is a reflink that shares the blocks until either file is written.
+    bool place(const fs::path& from, const fs::path& to) {
+        std::error_code ec;
+        fs::remove(to, ec);
+        if(hardlink){
+            fs::create_hard_link(from, to, ec);
+            if(!ec){
+                return true;
+            }
+        }
+#ifdef FICLONE
+        const int in = open(from.c_str(), O_RDONLY);
+        if(in >= 0){
+            const int out = open(to.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+            const bool cloned = out >= 0 && ioctl(out, FICLONE, in) == 0;
+            if(out >= 0){
+                close(out);
+            }
+            close(in);
+            if(cloned){
+                return true;
+            }
+        }
+#endif
+        fs::copy_file(from, to, fs::copy_options::overwrite_existing, ec);
+        return !ec;
+    }
+
+    // Put the cached meshes at the output paths. A missing entry, or one whose files do not have the sizes
+    // they were stored with, is a miss.
+    bool fetch(const string& dir, const string& key, const vector<string>& outputs) {
+        const fs::path entry = fs::path(dir) / key;
+        std::error_code ec;
+        vector<std::pair<string, long long>> sizes;
+        {
+            std::ifstream meta(entry / "meta");
+            string ext;
+            long long size;
+            while(meta >> ext >> size){
+                sizes.emplace_back(ext, size);
+            }
+        }
+        bool complete = !sizes.empty();
+        for(const auto& output : outputs){
+            auto it = std::find_if(sizes.begin(), sizes.end(),
+                                   [&](const std::pair<string, long long>& s) { return s.first == extension(output); });
+            complete = complete && it != sizes.end() && (long long)fs::file_size(entry / it->first, ec) == it->second;
+        }
+        if(!complete){
+            if(!sizes.empty()){
+                fs::remove_all(entry, ec);
+            }
+            update_totals(dir, [](Totals& t) { t.misses++; });
+            return false;
+        }
+        for(const auto& output : outputs){
+            if(!place(entry / extension(output), output)){
+                update_totals(dir, [](Totals& t) { t.misses++; });
+                return false;
+            }
+        }
+        fs::last_write_time(entry / "meta", fs::file_time_type::clock::now(), ec);
+        update_totals(dir, [](Totals& t) { t.hits++; });
+        return true;
+    }
+
+    // Add the freshly written meshes under key. The entry is built in a temporary directory and renamed
+    // into place, so other runs never see half of it.
+    void store(const string& dir, const string& key, const vector<string>& outputs) {
+        std::error_code ec;
+        const fs::path entry = fs::path(dir) / key;
+        const fs::path temp = fs::path(dir) / (".tmp-" + key + "-" + std::to_string(getpid()));
+        fs::remove_all(temp, ec);
+        if(!fs::create_directories(temp, ec)){
+            return;
+        }
+        std::ofstream meta(temp / "meta");
+        for(const auto& output : outputs){
+            const fs::path cached = temp / extension(output);
+            const auto size = fs::file_size(output, ec);
+            if(ec || !place(output, cached)){
+                fs::remove_all(temp, ec);
+                return;
+            }
+            meta << extension(output) << ' ' << size << '\n';
+        }
+        meta.close();
+        fs::rename(temp, entry, ec);
+        if(ec){
+            // another run stored it first
+            fs::remove_all(temp, ec);
+            return;
+        }
+        update_totals(dir, [](Totals& t) { t.stores++; });
+    }
+
+    struct Entry {
+        fs::path path;
+        fs::file_time_type used;
+        long long bytes = 0;
+    };
+
+    vector<Entry> list_entries(const string& dir) {
+        vector<Entry> entries;
+        std::error_code ec;
+        for(const auto& item : fs::directory_iterator(dir, ec)){
+            if(!item.is_directory(ec) || item.path().filename().string()[0] == '.'){
+                continue;
+            }
+            Entry e;
+            e.path = item.path();
+            e.used = fs::last_write_time(e.path / "meta", ec);
+            if(ec){
+                e.used = fs::file_time_type::min();
+            }
+            for(const auto& file : fs::directory_iterator(e.path, ec)){
+                e.bytes += file.file_size(ec);
+            }
+            entries.push_back(e);
+        }
+        return entries;
+    }
+
+    // Remove the least recently used entries until the cache takes at most max_bytes, keeping the entry
+    // under key (just fetched or stored) even if it alone is larger.
+    void evict(const string& dir, const string& key) {
+        Lock lock(dir);
+        auto entries = list_entries(dir);
+        long long total = 0;
+        for(const auto& e : entries){
+            total += e.bytes;
+        }
+        if(total <= max_bytes){
+            return;
+        }
+        std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) { return a.used < b.used; });
+        Totals t = read_totals(dir);
+        std::error_code ec;
+        for(const auto& e : entries){
+            if(total <= max_bytes){
+                break;
+            }
+            if(e.path.filename() == key){
+                continue;
+            }
+            fs::remove_all(e.path, ec);
+            total -= e.bytes;
+            t.evictions++;
+            t.evicted_bytes += e.bytes;
+        }
+        write_totals(dir, t);
+    }
+
+    void print_totals(const string& dir) {
+        const auto entries = list_entries(dir);
+        long long bytes = 0;
+        for(const auto& e : entries){
+            bytes += e.bytes;
+        }
+        const Totals t = read_totals(dir);
+        const long long lookups = t.hits + t.misses;
+        std::printf("cache %s: %zu entries, %.1f of %.1f MiB; %lld hits, %lld misses (%.0f%% hits), %lld stored, "
+                    "%lld evicted (%.1f MiB)\n", dir.c_str(), entries.size(), bytes / 1048576.0, max_bytes / 1048576.0,
+                    t.hits, t.misses, lookups ? 100.0 * t.hits / lookups : 0.0, t.stores, t.evictions,
+                    t.evicted_bytes / 1048576.0);
+    }
+}
+
+#endif //STARTKIT_CACHE_H
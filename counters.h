@@ -0,0 +1,127 @@
+//
+// Event counters for the inner loops of triangulation, merging and rectangle packing, kept per thread and
+// added to the --stats counts. Only built in with STARTKIT_COUNTERS defined; otherwise COUNT is empty.
+//
+// The CDT headers count through their CDT_COUNT hook, which is only wired up here if this file is
+// included before them.
+//
+
+#ifndef STARTKIT_COUNTERS_H
+#define STARTKIT_COUNTERS_H
+
+#ifdef STARTKIT_COUNTERS
+#if defined(CDT_obwOaxOTdAWcLNTlNnaq) || defined(PREDICATES_H_INCLUDED)
+#error "counters.h must be included before CDT.h and predicates.h"
+#endif
+#include <algorithm>
+#include <vector>
+#include <mutex>
+#include "stats.h"
+
+namespace counters {
+    using std::vector;
+
+    const bool compiled = true;
+
+    enum Counter {
+        cdt_flips,               // edge flips in ensureDelaunayByEdgeFlips and rectcdt
+        cdt_walk_steps,          // triangles stepped through by walkTriangles
+        cdt_predicate_fallbacks, // orient2d / incircle calls the floating point filter could not decide
+        cdt_pseudopolygons,      // pseudo-polygons retriangulated after inserting a constraint edge
+        merge_stale_pops,        // smart_merge heap entries that no longer matched best_merge
+        merge_can_merge,         // can_merge calls
+        merge_ring_steps,        // vertices walked by can_merge looking for the shared edge
+        rect_repushes,           // make_rectangles heap entries pushed again with a smaller rectangle
+        rect_clearance_steps,    // cells scanned by the lazy clearance lookups
+        num_counters
+    };
+
+    const char* const names[num_counters] = {
+        "cdt.flips", "cdt.walk_steps", "cdt.predicate_fallbacks", "cdt.pseudopolygons",
+        "merge.stale_pops", "merge.can_merge", "merge.ring_steps",
+        "rec.repushes", "rec.clearance_steps",
+    };
+
+    // Each thread adds to its own block. When a thread exits, its block is added to retired and dropped, so
+    // nothing is lost when the workers are joined and a process that keeps starting threads (-serve) does
+    // not keep a block for every thread it ever ran.
+    struct Block {
+        long long values[num_counters] = {};
+    };
+
+    std::mutex blocks_mutex;
+    vector<Block*> blocks;
+    long long retired[num_counters] = {};
+
+    struct ThreadBlock {
+        Block block;
+
+        ThreadBlock() {
+            std::lock_guard<std::mutex> guard(blocks_mutex);
+            blocks.push_back(&block);
+        }
+
+        ~ThreadBlock() {
+            std::lock_guard<std::mutex> guard(blocks_mutex);
+            for(int i = 0; i < num_counters; i++){
+                retired[i] += block.values[i];
+            }
+            blocks.erase(std::find(blocks.begin(), blocks.end(), &block));
+        }
+    };
+
+    inline Block& thread_block() {
+        thread_local Block* block = nullptr;
+        if(block == nullptr){
+            thread_local ThreadBlock owner;
+            block = &owner.block;
+        }
+        return *block;
+    }
+
+    // Sum every thread's counters into the stats counts. Call it once the worker threads are joined.
+    void add_to_stats() {
+        long long totals[num_counters] = {};
+        {
+            std::lock_guard<std::mutex> guard(blocks_mutex);
+            for(int i = 0; i < num_counters; i++){
+                totals[i] = retired[i];
+            }
+            for(const Block* block : blocks){
+                for(int i = 0; i < num_counters; i++){
+                    totals[i] += block->values[i];
+                }
+            }
+        }
+        for(int i = 0; i < num_counters; i++){
+            stats::count(names[i], totals[i]);
+        }
+    }
+
+    // Start counting from zero, for a process that converts more than one map.
+    void reset() {
+        std::lock_guard<std::mutex> guard(blocks_mutex);
+        std::fill(retired, retired + num_counters, 0);
+        for(Block* block : blocks){
+            std::fill(block->values, block->values + num_counters, 0);
+        }
+    }
+}
+
+#define COUNT(counter, n) (counters::thread_block().values[counters::counter] += (n))
+#define CDT_COUNT(counter, n) COUNT(counter, n)
+
+#else
+
+namespace counters {
+    const bool compiled = false;
+
+    inline void add_to_stats() {}
+    inline void reset() {}
+}
+
+#define COUNT(counter, n) ((void)0)
+
+#endif
+
+#endif //STARTKIT_COUNTERS_H
@@ -40,6 +40,9 @@ weight of 0.
 #include <stdlib.h>
 #include <cassert>
 #include <fstream>
+#include <array>
+#include "stats.h"
+#include "trace.h"
 
 #define FORMAT_VERSION 1
 namespace grid2poly {
@@ -195,10 +198,13 @@ namespace grid2poly {
 
 
     void get_id_and_elevation() {
+        TRACE_SCOPE("get_id_and_elevation");
         // Initialise polygon_id with -1s.
         polygon_id = std::vector<vint>(map_height, vint(map_width, -1));
         // Initialise id_to_elevation as empty vint.
         id_to_elevation.clear();
+        next_id = 0;
+        id_to_first_cell.clear();
 
         // Do a Dijkstra-like floodfill. Need an "open list".
         // We want to prioritise search nodes with a lower elevation, then the ones
@@ -301,6 +307,7 @@ namespace grid2poly {
     }
 
     void make_edges() {
+        TRACE_SCOPE("make_edges");
         // Fill in id_to_neighbours, which, for each lattice point, is a mapping
         // from an ID to the two neighbouring lattice points where the polygon
         // is connected to.
@@ -364,6 +371,7 @@ namespace grid2poly {
     }
 
     void generate_polygons() {
+        TRACE_SCOPE("generate_polygons");
         using namespace std;
         // Don't forget to initialise id_to_polygon!
         id_to_polygon = std::vector<vpoint>(next_id);
@@ -550,6 +558,7 @@ namespace grid2poly {
 
 
     void output_polymap(string filename) {
+        TRACE_SCOPE("output_polymap");
         ofstream fout(filename);
 
         fout << "poly" << std::endl;
@@ -608,6 +617,88 @@ namespace grid2poly {
         }
     }
 
+    // Find the constraint segments of the mesh straight from the elevation grid, without tracing polygons.
+    // Vertices are the lattice points where the boundary of some id turns or pinches, numbered in row-major
+    // order. Each boundary run between two vertices becomes one segment {first vertex, second vertex, region},
+    // where region is the traversable id whose area the segment bounds: the owning id if it is traversable,
+    // else the traversable id the obstacle was reached from during the floodfill.
+    void make_constraints(vpoint &vertices, std::vector<std::array<int, 3>> &segments) {
+        TRACE_SCOPE("make_constraints");
+        vertices.clear();
+        segments.clear();
+
+        std::vector<int> region(next_id, -1);
+        for (int id = 0; id < next_id; id++) {
+            const int x = id_to_first_cell[id].first, y = id_to_first_cell[id].second;
+            if (map_traversable[y][x]) {
+                region[id] = id;
+                continue;
+            }
+            for (int dy = -1; dy <= 1 && region[id] == -1; dy++) {
+                for (int dx = -1; dx <= 1; dx++) {
+                    const int nx = x + dx, ny = y + dy;
+                    if (nx < 0 || nx >= map_width || ny < 0 || ny >= map_height) {
+                        continue;
+                    }
+                    const int other = polygon_id[ny][nx];
+                    if (map_traversable[ny][nx] && id_to_elevation[other] == id_to_elevation[id] - 1) {
+                        region[id] = other;
+                        break;
+                    }
+                }
+            }
+        }
+
+        // The owner of a boundary edge is the id with the higher elevation on either side, -1 for no edge.
+        auto owner = [](int a, int b) {
+            const int a_ele = (a == -1 ? 0 : id_to_elevation[a]);
+            const int b_ele = (b == -1 ? 0 : id_to_elevation[b]);
+            if (a_ele == b_ele) {
+                return -1;
+            }
+            return a_ele > b_ele ? a : b;
+        };
+        // horizontal edge from (x, y) to (x + 1, y)
+        auto h_owner = [&owner](int x, int y) {
+            if (x < 0 || x >= map_width) {
+                return -1;
+            }
+            return owner(y == 0 ? -1 : polygon_id[y - 1][x], y == map_height ? -1 : polygon_id[y][x]);
+        };
+        // vertical edge from (x, y) to (x, y + 1)
+        auto v_owner = [&owner](int x, int y) {
+            if (y < 0 || y >= map_height) {
+                return -1;
+            }
+            return owner(x == 0 ? -1 : polygon_id[y][x - 1], x == map_width ? -1 : polygon_id[y][x]);
+        };
+
+        // vertex where the vertical run currently open in each column started
+        std::vector<int> column_start(map_width + 1, -1);
+        for (int y = 0; y <= map_height; y++) {
+            int row_start = -1;
+            for (int x = 0; x <= map_width; x++) {
+                const int left = h_owner(x - 1, y), right = h_owner(x, y);
+                const int up = v_owner(x, y - 1), down = v_owner(x, y);
+                const bool corner = (left != -1 && (left == up || left == down)) ||
+                                    (right != -1 && (right == up || right == down));
+                if (!corner) {
+                    continue;
+                }
+                const int v = vertices.size();
+                vertices.push_back({x, y});
+                if (left != -1) {
+                    segments.push_back({row_start, v, region[left]});
+                }
+                row_start = (right != -1 ? v : -1);
+                if (up != -1) {
+                    segments.push_back({column_start[x], v, region[up]});
+                }
+                column_start[x] = (down != -1 ? v : -1);
+            }
+        }
+    }
+
     void print_map() {
         for (auto row: map_traversable) {
             for (auto t: row) {
@@ -649,7 +740,8 @@ namespace grid2poly {
         }
     }
 
-    void convertGrid2Poly(const std::vector<bool> &bits, int width, int height, const std::string filename) {
+    // Copy the grid into map_traversable, which the phases below work on.
+    void set_map(const std::vector<bool> &bits, int width, int height) {
         map_height = height;
         map_width = width;
         map_traversable = std::vector<vbool>(map_height, vbool(map_width));
@@ -658,14 +750,50 @@ namespace grid2poly {
             int x = i % width;
             map_traversable[y][x] = bits[i];
         }
+    }
 
-        get_id_and_elevation();
-        make_edges();
-        generate_polygons();
+    void convertGrid2Poly(const std::vector<bool> &bits, int width, int height, const std::string filename) {
+        set_map(bits, width, height);
+        {
+            stats::Scope scope("poly.flood_fill");
+            get_id_and_elevation();
+        }
+        {
+            stats::Scope scope("poly.make_edges");
+            make_edges();
+        }
+        {
+            stats::Scope scope("poly.trace");
+            generate_polygons();
+        }
 //    print_polymap();
-        output_polymap(filename);
+        {
+            stats::Scope scope("poly.write");
+            output_polymap(filename);
+        }
+        long long traced = 0;
+        for (const vpoint &points: id_to_polygon) {
+            traced += !points.empty();
+        }
+        stats::count("poly.regions", next_id);
+        stats::count("poly.traced_polygons", traced);
 
     }
+
+    void convertGrid2Constraints(const std::vector<bool> &bits, int width, int height, vpoint &vertices,
+                                 std::vector<std::array<int, 3>> &segments) {
+        set_map(bits, width, height);
+        {
+            stats::Scope scope("poly.flood_fill");
+            get_id_and_elevation();
+        }
+        {
+            stats::Scope scope("poly.constraints");
+            make_constraints(vertices, segments);
+        }
+        stats::count("poly.regions", next_id);
+        stats::count("poly.constraint_segments", segments.size());
+    }
 }
 
 #endif //STARTKIT_GRID2POLY_H
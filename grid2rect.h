@@ -12,6 +12,9 @@
 #include <iomanip>
 #include <queue>
 #include <algorithm>
+#include "counters.h"
+#include "stats.h"
+#include "trace.h"
 
 using namespace std;
 
@@ -217,6 +220,7 @@ namespace grid2rect {
             out++;
             y--;
         }
+        COUNT(rect_clearance_steps, out + 1);
         return out;
     }
 
@@ -241,6 +245,7 @@ namespace grid2rect {
             out++;
             x--;
         }
+        COUNT(rect_clearance_steps, out + 1);
         return out;
     }
 
@@ -352,6 +357,7 @@ namespace grid2rect {
     }
 
     void make_rectangles() {
+        TRACE_SCOPE("make_rectangles");
         // Gets the best rectangle and takes that.
         // Repeat until there are no more rectangles.
         priority_queue<SearchNode> pq;
@@ -374,6 +380,7 @@ namespace grid2rect {
                 // Not the right node.
                 // Push it on so we can get to it later if r.h isn't 0.
                 if (r.h != 0) {
+                    COUNT(rect_repushes, 1);
                     pq.push({node.y, node.x, r.h});
                 }
                 continue;
@@ -655,7 +662,8 @@ namespace grid2rect {
         }
     }
 
-    void convertgrid2rect(const std::vector<bool> &bits, int width, int height, const std::string output_filename) {
+    // Copy the grid in and reset everything make_rectangles fills in, so it can run again.
+    void set_map(const std::vector<bool> &bits, int width, int height) {
         map_height = height;
         map_width = width;
 //    map_traversable = std::vector<vbool>(map_height, vbool(map_width));
@@ -671,15 +679,29 @@ namespace grid2rect {
             int x = i % width;
             map_traversable[y][x] = bits[i];
         }
+        final_rectangles.clear();
+        final_vertices.clear();
+        cur_rect_id = 0;
+        cur_vertex_id = 0;
+    }
 
+    void convertgrid2rect(const std::vector<bool> &bits, int width, int height, const std::string output_filename) {
+        TRACE_SCOPE("convertgrid2rect");
+        set_map(bits, width, height);
 
 //    read_map(fin);
 
 
-        ofstream fout(output_filename);
-        make_rectangles();
+        {
+            stats::Scope scope("rec.rectangles");
+            make_rectangles();
+        }
+        stats::count("rec.vertices", cur_vertex_id);
+        stats::count("rec.polygons", cur_rect_id);
         // print_rects();
         // print_ids();
+        stats::Scope scope("rec.write");
+        ofstream fout(output_filename);
         fout << "mesh" << endl;
         fout << 2 << endl;
         fout << cur_vertex_id << " " << cur_rect_id << endl;
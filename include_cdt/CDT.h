@@ -232,8 +232,8 @@ CDT_EXPORT EdgeUSet extractEdgesFromTriangles(const TriangleVec& triangles);
  * @param pieceToOriginals maps pieces to original edges
  * @return mapping of original edges to pieces
  */
-CDT_EXPORT unordered_map<Edge, EdgeVec>
-EdgeToPiecesMapping(const unordered_map<Edge, EdgeVec>& pieceToOriginals);
+CDT_EXPORT EdgeEdgesMap
+EdgeToPiecesMapping(const EdgeEdgesMap& pieceToOriginals);
 
 /*!
  * Convert edge-to-pieces mapping into edge-to-split-vertices mapping
@@ -245,7 +245,7 @@ EdgeToPiecesMapping(const unordered_map<Edge, EdgeVec>& pieceToOriginals);
  */
 template <typename T>
 CDT_EXPORT unordered_map<Edge, std::vector<VertInd> > EdgeToSplitVertices(
-    const unordered_map<Edge, EdgeVec>& edgeToPieces,
+    const EdgeEdgesMap& edgeToPieces,
     const std::vector<V2d<T> >& vertices);
 
 /// @}
@@ -382,7 +382,7 @@ DuplicatesInfo RemoveDuplicatesAndRemapEdges(
 
 template <typename T>
 unordered_map<Edge, std::vector<VertInd> > EdgeToSplitVertices(
-    const unordered_map<Edge, EdgeVec>& edgeToPieces,
+    const EdgeEdgesMap& edgeToPieces,
     const std::vector<V2d<T> >& vertices)
 {
     typedef std::pair<VertInd, T> VertCoordPair;
@@ -395,7 +395,7 @@ unordered_map<Edge, std::vector<VertInd> > EdgeToSplitVertices(
     } comparePred;
 
     unordered_map<Edge, std::vector<VertInd> > edgeToSplitVerts;
-    typedef unordered_map<Edge, EdgeVec>::const_iterator It;
+    typedef EdgeEdgesMap::const_iterator It;
     for(It e2pIt = edgeToPieces.begin(); e2pIt != edgeToPieces.end(); ++e2pIt)
     {
         const Edge& e = e2pIt->first;
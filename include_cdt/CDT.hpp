@@ -84,11 +84,11 @@ extractEdgesFromTriangles(const TriangleVec& triangles)
     return edges;
 }
 
-CDT_INLINE_IF_HEADER_ONLY unordered_map<Edge, EdgeVec>
-EdgeToPiecesMapping(const unordered_map<Edge, EdgeVec>& pieceToOriginals)
+CDT_INLINE_IF_HEADER_ONLY EdgeEdgesMap
+EdgeToPiecesMapping(const EdgeEdgesMap& pieceToOriginals)
 {
-    unordered_map<Edge, EdgeVec> originalToPieces;
-    typedef unordered_map<Edge, EdgeVec>::const_iterator Cit;
+    EdgeEdgesMap originalToPieces;
+    typedef EdgeEdgesMap::const_iterator Cit;
     for(Cit ptoIt = pieceToOriginals.begin(); ptoIt != pieceToOriginals.end();
         ++ptoIt)
     {
@@ -40,6 +40,12 @@ typedef char couldnt_parse_cxx_standard[-1]; ///< Error: couldn't parse standard
 #define CDT_EXPORT
 #endif
 
+/// Event counting hook (see counters.h); does nothing unless defined before
+/// the CDT headers
+#ifndef CDT_COUNT
+#define CDT_COUNT(counter, n) ((void)0)
+#endif
+
 #include <algorithm>
 #include <cassert>
 #include <cmath>
@@ -87,6 +93,14 @@ using boost::unordered_set;
 } // namespace CDT
 #endif
 
+// Flat open-addressing tables pack edges into 64-bit keys: they need 32-bit
+// plain integer indices
+#if defined(CDT_CXX11_IS_SUPPORTED) && !defined(CDT_USE_64_BIT_INDEX_TYPE) &&   \
+    !defined(CDT_USE_STRONG_TYPING)
+#define CDT_USE_FLAT_HASH_TABLES
+#include "FlatHash.h"
+#endif
+
 namespace CDT
 {
 
@@ -242,10 +256,36 @@ inline Edge edge_make(VertInd iV1, VertInd iV2)
     return Edge(iV1, iV2);
 }
 
-typedef std::vector<Edge> EdgeVec;                ///< Vector of edges
-typedef unordered_set<Edge> EdgeUSet;             ///< Hash table of edges
-typedef unordered_set<TriInd> TriIndUSet;         ///< Hash table of triangles
-typedef unordered_map<TriInd, TriInd> TriIndUMap; ///< Triangle hash map
+typedef std::vector<Edge> EdgeVec; ///< Vector of edges
+
+#ifdef CDT_USE_FLAT_HASH_TABLES
+namespace detail
+{
+/// Edge packed as (v1 << 32) | v2
+template <>
+struct FlatHashKey<Edge>
+{
+    static std::uint64_t pack(const Edge& e)
+    {
+        return std::uint64_t(e.v1()) << 32 | e.v2();
+    }
+    static Edge unpack(const std::uint64_t packed)
+    {
+        return Edge(VertInd(packed >> 32), VertInd(packed & 0xffffffff));
+    }
+};
+} // namespace detail
+
+typedef FlatHashSet<Edge> EdgeUSet;              ///< Hash table of edges
+typedef FlatHashSet<TriInd> TriIndUSet;          ///< Hash table of triangles
+typedef FlatHashMap<TriInd, TriInd> TriIndUMap;  ///< Triangle hash map
+typedef FlatHashMap<Edge, EdgeVec> EdgeEdgesMap; ///< Edge to edges hash map
+#else
+typedef unordered_set<Edge> EdgeUSet;              ///< Hash table of edges
+typedef unordered_set<TriInd> TriIndUSet;          ///< Hash table of triangles
+typedef unordered_map<TriInd, TriInd> TriIndUMap;  ///< Triangle hash map
+typedef unordered_map<Edge, EdgeVec> EdgeEdgesMap; ///< Edge to edges hash map
+#endif
 
 /// Triangulation triangle (counter-clockwise winding)
 /*
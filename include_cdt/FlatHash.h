@@ -0,0 +1,520 @@
+/// @file
+/// Flat open-addressing hash tables used for CDT's edge and index
+/// bookkeeping
+
+#ifndef CDT_FLAT_HASH_H
+#define CDT_FLAT_HASH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <utility>
+#include <vector>
+
+namespace CDT
+{
+namespace detail
+{
+
+/**
+ * Packs a key into a 64-bit integer and back. The two largest 64-bit values
+ * are reserved for marking empty and erased slots.
+ * Default implementation is for unsigned integer keys up to 32 bits.
+ * @note keys don't need to be default-constructible: free slots hold
+ * unpack(0)
+ */
+template <typename Key>
+struct FlatHashKey
+{
+    static std::uint64_t pack(const Key& key)
+    {
+        return static_cast<std::uint64_t>(key);
+    }
+    static Key unpack(const std::uint64_t packed)
+    {
+        return static_cast<Key>(packed);
+    }
+};
+
+} // namespace detail
+
+/**
+ * Hash map with open addressing and linear probing over packed 64-bit keys.
+ * Keys are stored in their own array, so lookups touch 8 bytes per probed
+ * slot and inserting never allocates unless the table grows.
+ * @note erasing marks the slot as erased: other elements never move, and
+ * iterators to them stay valid
+ * @note clear() keeps the allocated slots for re-use, and reserve() on an
+ * empty map sizes the table for the given number of elements within them, so
+ * a table re-used for fewer elements is also cleared and iterated at that size
+ */
+template <typename Key, typename Mapped>
+class FlatHashMap
+{
+public:
+    typedef Key key_type;
+    typedef Mapped mapped_type;
+    typedef std::pair<Key, Mapped> value_type;
+    typedef std::size_t size_type;
+
+    class const_iterator;
+
+    /// Iterator over the stored key-value pairs
+    class iterator
+    {
+    public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef FlatHashMap::value_type value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef FlatHashMap::value_type* pointer;
+        typedef FlatHashMap::value_type& reference;
+
+        iterator()
+            : m_map(NULL)
+            , m_slot(0)
+        {}
+        value_type& operator*() const
+        {
+            return m_map->m_values[m_slot];
+        }
+        value_type* operator->() const
+        {
+            return &m_map->m_values[m_slot];
+        }
+        iterator& operator++()
+        {
+            m_slot = m_map->nextLive(m_slot + 1);
+            return *this;
+        }
+        iterator operator++(int)
+        {
+            const iterator it = *this;
+            ++*this;
+            return it;
+        }
+        bool operator==(const iterator& other) const
+        {
+            return m_slot == other.m_slot;
+        }
+        bool operator!=(const iterator& other) const
+        {
+            return m_slot != other.m_slot;
+        }
+
+    private:
+        friend class FlatHashMap;
+        friend class const_iterator;
+        iterator(FlatHashMap* map, const std::size_t slot)
+            : m_map(map)
+            , m_slot(slot)
+        {}
+        FlatHashMap* m_map;
+        std::size_t m_slot;
+    };
+
+    /// Iterator over the stored key-value pairs (read-only)
+    class const_iterator
+    {
+    public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef FlatHashMap::value_type value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef const FlatHashMap::value_type* pointer;
+        typedef const FlatHashMap::value_type& reference;
+
+        const_iterator()
+            : m_map(NULL)
+            , m_slot(0)
+        {}
+        const_iterator(const iterator& it)
+            : m_map(it.m_map)
+            , m_slot(it.m_slot)
+        {}
+        const value_type& operator*() const
+        {
+            return m_map->m_values[m_slot];
+        }
+        const value_type* operator->() const
+        {
+            return &m_map->m_values[m_slot];
+        }
+        const_iterator& operator++()
+        {
+            m_slot = m_map->nextLive(m_slot + 1);
+            return *this;
+        }
+        const_iterator operator++(int)
+        {
+            const const_iterator it = *this;
+            ++*this;
+            return it;
+        }
+        bool operator==(const const_iterator& other) const
+        {
+            return m_slot == other.m_slot;
+        }
+        bool operator!=(const const_iterator& other) const
+        {
+            return m_slot != other.m_slot;
+        }
+
+    private:
+        friend class FlatHashMap;
+        const_iterator(const FlatHashMap* map, const std::size_t slot)
+            : m_map(map)
+            , m_slot(slot)
+        {}
+        const FlatHashMap* m_map;
+        std::size_t m_slot;
+    };
+
+    FlatHashMap()
+        : m_capacity(0)
+        , m_size(0)
+        , m_used(0)
+    {}
+
+    size_type size() const
+    {
+        return m_size;
+    }
+    bool empty() const
+    {
+        return m_size == 0;
+    }
+
+    iterator begin()
+    {
+        return iterator(this, nextLive(0));
+    }
+    iterator end()
+    {
+        return iterator(this, m_capacity);
+    }
+    const_iterator begin() const
+    {
+        return const_iterator(this, nextLive(0));
+    }
+    const_iterator end() const
+    {
+        return const_iterator(this, m_capacity);
+    }
+
+    iterator find(const Key& key)
+    {
+        return iterator(this, findSlot(pack(key)));
+    }
+    const_iterator find(const Key& key) const
+    {
+        return const_iterator(this, findSlot(pack(key)));
+    }
+    size_type count(const Key& key) const
+    {
+        return findSlot(pack(key)) == m_capacity ? 0 : 1;
+    }
+
+    /// Insert default-constructed value if key is not present
+    /// @return iterator to the element and whether it was inserted
+    std::pair<iterator, bool> try_emplace(const Key& key)
+    {
+        const std::uint64_t packed = pack(key);
+        std::size_t slot = findSlot(packed);
+        if(slot != m_capacity)
+            return std::make_pair(iterator(this, slot), false);
+        if((m_used + 1) * 4 > m_capacity * 3)
+            rehash(m_size + 1);
+        slot = freeSlot(packed);
+        if(m_keys[slot] == emptyKey)
+            ++m_used;
+        m_keys[slot] = packed;
+        m_values[slot].first = key;
+        ++m_size;
+        return std::make_pair(iterator(this, slot), true);
+    }
+    std::pair<iterator, bool> insert(const value_type& value)
+    {
+        const std::pair<iterator, bool> res = try_emplace(value.first);
+        if(res.second)
+            res.first->second = value.second;
+        return res;
+    }
+    Mapped& operator[](const Key& key)
+    {
+        return try_emplace(key).first->second;
+    }
+
+    /// @return iterator to the element following the erased one
+    iterator erase(const const_iterator& it)
+    {
+        eraseSlot(it.m_slot);
+        return iterator(this, nextLive(it.m_slot + 1));
+    }
+    size_type erase(const Key& key)
+    {
+        const std::size_t slot = findSlot(pack(key));
+        if(slot == m_capacity)
+            return 0;
+        eraseSlot(slot);
+        return 1;
+    }
+
+    /// Remove all elements, keeping allocated slots
+    void clear()
+    {
+        if(m_used == 0)
+            return;
+        for(std::size_t i = 0; i < m_capacity; ++i)
+        {
+            if(m_keys[i] < erasedKey)
+                m_values[i].second = Mapped();
+            m_keys[i] = emptyKey;
+        }
+        m_size = 0;
+        m_used = 0;
+    }
+    /// Make room for the given number of elements without re-hashing
+    void reserve(const size_type n)
+    {
+        if(n * 4 > m_capacity * 3 || (m_size == 0 && m_capacity > 16))
+            rehash(n);
+    }
+    void swap(FlatHashMap& other)
+    {
+        m_keys.swap(other.m_keys);
+        m_values.swap(other.m_values);
+        std::swap(m_capacity, other.m_capacity);
+        std::swap(m_size, other.m_size);
+        std::swap(m_used, other.m_used);
+    }
+
+private:
+    static constexpr std::uint64_t emptyKey = ~std::uint64_t(0);
+    static constexpr std::uint64_t erasedKey = ~std::uint64_t(1);
+
+    static std::uint64_t pack(const Key& key)
+    {
+        return detail::FlatHashKey<Key>::pack(key);
+    }
+    /// Home slot of a packed key (64-bit finalizer of MurmurHash3)
+    std::size_t homeSlot(std::uint64_t packed) const
+    {
+        packed ^= packed >> 33;
+        packed *= 0xff51afd7ed558ccdULL;
+        packed ^= packed >> 33;
+        return static_cast<std::size_t>(packed) & (m_capacity - 1);
+    }
+    /// Slot holding the key, or m_capacity if not present
+    std::size_t findSlot(const std::uint64_t packed) const
+    {
+        if(m_size == 0)
+            return m_capacity;
+        const std::size_t mask = m_capacity - 1;
+        for(std::size_t i = homeSlot(packed);; i = (i + 1) & mask)
+        {
+            if(m_keys[i] == packed)
+                return i;
+            if(m_keys[i] == emptyKey)
+                return m_capacity;
+        }
+    }
+    /// First empty or erased slot on the probe sequence of an absent key
+    std::size_t freeSlot(const std::uint64_t packed) const
+    {
+        const std::size_t mask = m_capacity - 1;
+        std::size_t i = homeSlot(packed);
+        while(m_keys[i] < erasedKey)
+            i = (i + 1) & mask;
+        return i;
+    }
+    std::size_t nextLive(std::size_t slot) const
+    {
+        while(slot < m_capacity && m_keys[slot] >= erasedKey)
+            ++slot;
+        return slot;
+    }
+    void eraseSlot(const std::size_t slot)
+    {
+        m_keys[slot] = erasedKey;
+        m_values[slot].second = Mapped();
+        --m_size;
+    }
+    /// Re-insert live elements into a table sized for n elements, dropping
+    /// erased-slot markers. An empty table re-uses its allocated slots if
+    /// they are enough.
+    void rehash(const size_type n)
+    {
+        std::size_t capacity = 16;
+        while(capacity * 3 < n * 8)
+            capacity *= 2;
+        if(m_size == 0 && capacity <= m_keys.size())
+        {
+            clear();
+            m_capacity = capacity;
+            return;
+        }
+        std::vector<std::uint64_t> keys(capacity, emptyKey);
+        std::vector<value_type> values(
+            capacity,
+            value_type(detail::FlatHashKey<Key>::unpack(0), Mapped()));
+        keys.swap(m_keys);
+        values.swap(m_values);
+        const std::size_t oldCapacity = m_capacity;
+        m_capacity = capacity;
+        m_used = m_size;
+        for(std::size_t i = 0; i < oldCapacity; ++i)
+        {
+            if(keys[i] >= erasedKey)
+                continue;
+            const std::size_t slot = freeSlot(keys[i]);
+            m_keys[slot] = keys[i];
+            m_values[slot].first = values[i].first;
+            using std::swap;
+            swap(m_values[slot].second, values[i].second);
+        }
+    }
+
+    std::vector<std::uint64_t> m_keys; ///< packed keys or empty/erased marks
+    std::vector<value_type> m_values;  ///< values of slots with live keys
+    std::size_t m_capacity;            ///< slots in use, a power of two
+    std::size_t m_size;                ///< live elements
+    std::size_t m_used;                ///< live and erased elements
+};
+
+/**
+ * Hash set with open addressing over packed 64-bit keys
+ * @see FlatHashMap
+ */
+template <typename Key>
+class FlatHashSet
+{
+    struct Nothing
+    {};
+    typedef FlatHashMap<Key, Nothing> Table;
+
+public:
+    typedef Key key_type;
+    typedef Key value_type;
+    typedef std::size_t size_type;
+
+    /// Iterator over the stored keys
+    class const_iterator
+    {
+    public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef Key value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef const Key* pointer;
+        typedef const Key& reference;
+
+        const_iterator()
+        {}
+        const Key& operator*() const
+        {
+            return m_it->first;
+        }
+        const Key* operator->() const
+        {
+            return &m_it->first;
+        }
+        const_iterator& operator++()
+        {
+            ++m_it;
+            return *this;
+        }
+        const_iterator operator++(int)
+        {
+            const const_iterator it = *this;
+            ++m_it;
+            return it;
+        }
+        bool operator==(const const_iterator& other) const
+        {
+            return m_it == other.m_it;
+        }
+        bool operator!=(const const_iterator& other) const
+        {
+            return m_it != other.m_it;
+        }
+
+    private:
+        friend class FlatHashSet;
+        explicit const_iterator(const typename Table::const_iterator& it)
+            : m_it(it)
+        {}
+        typename Table::const_iterator m_it;
+    };
+    typedef const_iterator iterator;
+
+    FlatHashSet()
+    {}
+    template <typename InputIt>
+    FlatHashSet(InputIt first, const InputIt last)
+    {
+        for(; first != last; ++first)
+            insert(*first);
+    }
+
+    size_type size() const
+    {
+        return m_table.size();
+    }
+    bool empty() const
+    {
+        return m_table.empty();
+    }
+    const_iterator begin() const
+    {
+        return const_iterator(m_table.begin());
+    }
+    const_iterator end() const
+    {
+        return const_iterator(m_table.end());
+    }
+    const_iterator find(const Key& key) const
+    {
+        return const_iterator(m_table.find(key));
+    }
+    size_type count(const Key& key) const
+    {
+        return m_table.count(key);
+    }
+    std::pair<iterator, bool> insert(const Key& key)
+    {
+        const std::pair<typename Table::iterator, bool> res =
+            m_table.try_emplace(key);
+        return std::make_pair(const_iterator(res.first), res.second);
+    }
+    template <typename InputIt>
+    void insert(InputIt first, const InputIt last)
+    {
+        for(; first != last; ++first)
+            insert(*first);
+    }
+    iterator erase(const const_iterator& it)
+    {
+        return const_iterator(m_table.erase(it.m_it));
+    }
+    size_type erase(const Key& key)
+    {
+        return m_table.erase(key);
+    }
+    void clear()
+    {
+        m_table.clear();
+    }
+    void reserve(const size_type n)
+    {
+        m_table.reserve(n);
+    }
+    void swap(FlatHashSet& other)
+    {
+        m_table.swap(other.m_table);
+    }
+
+private:
+    Table m_table;
+};
+
+} // namespace CDT
+
+#endif // header guard
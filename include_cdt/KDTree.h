@@ -89,6 +89,7 @@ public:
               std::numeric_limits<coord_type>::max()))
         , m_size(0)
         , m_isRootBoxInitialized(false)
+        , m_nNodes(0)
         , m_tasksStack(InitialStackDepth, NearestTask())
     {
         m_root = addNewNode();
@@ -101,11 +102,38 @@ public:
         , m_max(max)
         , m_size(0)
         , m_isRootBoxInitialized(true)
+        , m_nNodes(0)
         , m_tasksStack(InitialStackDepth, NearestTask())
     {
         m_root = addNewNode();
     }
 
+    /// Remove all points, keeping allocated nodes for re-use
+    void clear()
+    {
+        clear(
+            point_type::make(
+                -std::numeric_limits<coord_type>::max(),
+                -std::numeric_limits<coord_type>::max()),
+            point_type::make(
+                std::numeric_limits<coord_type>::max(),
+                std::numeric_limits<coord_type>::max()));
+        m_isRootBoxInitialized = false;
+    }
+
+    /// Remove all points and set bounding box known in advance, keeping
+    /// allocated nodes for re-use
+    void clear(const point_type& min, const point_type& max)
+    {
+        m_rootDir = NodeSplitDirection::X;
+        m_min = min;
+        m_max = max;
+        m_size = 0;
+        m_isRootBoxInitialized = true;
+        m_nNodes = 0;
+        m_root = addNewNode();
+    }
+
     CDT::VertInd size() const
     {
         return m_size;
@@ -256,7 +284,15 @@ private:
     /// Add a new node and return it's index in nodes buffer
     node_index addNewNode()
     {
-        const node_index newNodeIndex = static_cast<node_index>(m_nodes.size());
+        const node_index newNodeIndex = m_nNodes++;
+        if(newNodeIndex < m_nodes.size())
+        {
+            // re-use node left over from before clear()
+            Node& n = m_nodes[newNodeIndex];
+            n.setChildren(node_index(0), node_index(0));
+            n.data.clear();
+            return newNodeIndex;
+        }
         m_nodes.push_back(Node());
         return newNodeIndex;
     }
@@ -379,6 +415,7 @@ private:
     CDT::VertInd m_size;
 
     bool m_isRootBoxInitialized;
+    node_index m_nNodes; ///< nodes in use, m_nodes may hold more for re-use
 
     // used for nearest query
     struct NearestTask
@@ -37,7 +37,7 @@ public:
             min = V2d_t::make(std::min(min.x, it->x), std::min(min.y, it->y));
             max = V2d_t::make(std::max(max.x, it->x), std::max(max.y, it->y));
         }
-        m_kdTree = KDTree_t(min, max);
+        m_kdTree.clear(min, max);
         for(VertInd i(0); i < points.size(); ++i)
         {
             m_kdTree.insert(i, points);
@@ -66,6 +66,12 @@ public:
         return !size();
     }
 
+    /// Remove all points, keeping allocated memory for re-use
+    void clear()
+    {
+        m_kdTree.clear();
+    }
+
 private:
     typedef KDTree::KDTree<
         TCoordType,
@@ -91,6 +91,18 @@ struct CDT_EXPORT IntersectingConstraintEdges
 typedef unsigned short LayerDepth;
 typedef LayerDepth BoundaryOverlapCount;
 
+#ifdef CDT_USE_FLAT_HASH_TABLES
+/// Edge to boundary overlap count hash map
+typedef FlatHashMap<Edge, BoundaryOverlapCount> EdgeOverlapCountMap;
+/// Triangle to layer depth hash map
+typedef FlatHashMap<TriInd, LayerDepth> TriIndLayerDepthMap;
+#else
+/// Edge to boundary overlap count hash map
+typedef unordered_map<Edge, BoundaryOverlapCount> EdgeOverlapCountMap;
+/// Triangle to layer depth hash map
+typedef unordered_map<TriInd, LayerDepth> TriIndLayerDepthMap;
+#endif
+
 /**
  * @defgroup Triangulation Triangulation Class
  * Class performing triangulations.
@@ -121,14 +133,14 @@ public:
      * @note needed for handling depth calculations and hole-removel in case of
      * overlapping boundaries
      */
-    unordered_map<Edge, BoundaryOverlapCount> overlapCount;
+    EdgeOverlapCountMap overlapCount;
 
     /** Stores list of original edges represented by a given fixed edge
      * @note map only has entries for edges where multiple original fixed edges
      * overlap or where a fixed edge is a part of original edge created by
      * conforming Delaunay triangulation vertex insertion
      */
-    unordered_map<Edge, EdgeVec> pieceToOriginals;
+    EdgeEdgesMap pieceToOriginals;
 
     /*____ API _____*/
     /// Default constructor
@@ -290,11 +302,36 @@ public:
      * @note supports overlapping or touching boundaries
      */
     void eraseOuterTrianglesAndHoles();
+    /**
+     * Remove all vertices, triangles and constraint edges so the
+     * triangulation can be re-used. Allocated memory is kept, so re-using one
+     * object for many triangulations avoids most of the allocations.
+     */
+    void clear();
+    /**
+     * Reserve storage for the expected size of the triangulation so that
+     * containers are not re-grown while inserting
+     * @param nVertices number of vertices that will be inserted
+     * @param nTriangles number of triangles including super-triangle ones,
+     * e.g., from Euler's formula: 2 * nVertices + 1
+     * @param nFixedEdges number of constraint edges that will be inserted
+     */
+    void reserve(
+        std::size_t nVertices,
+        std::size_t nTriangles,
+        std::size_t nFixedEdges);
     /**
      * Call this method after directly setting custom super-geometry via
      * vertices and triangles members
      */
     void initializedWithCustomSuperGeometry();
+    /**
+     * Call this method after directly setting vertices (starting with the
+     * three super-triangle vertices), triangles and vertex-adjacent triangles
+     * (see VertTrisInternal) of a triangulation built outside this class
+     * @note nearest point locator is initialized lazily on next insertion
+     */
+    void initializedWithSuperTriangle();
 
     /**
      * Check if the triangulation was finalized with `erase...` method and
@@ -366,7 +403,7 @@ private:
     void ensureDelaunayByEdgeFlips(
         const V2d<T>& v1,
         VertInd iV1,
-        std::stack<TriInd>& triStack);
+        TriIndVec& triStack);
     /// Flip fixed edges and return a list of flipped fixed edges
     std::vector<Edge> insertVertex_FlipFixedEdges(VertInd iV1);
 
@@ -461,10 +498,10 @@ private:
         const V2d<T>& a,
         const V2d<T>& b,
         T orientationTolerance = T(0)) const;
-    /// Returns indices of three resulting triangles
-    std::stack<TriInd> insertVertexInsideTriangle(VertInd v, TriInd iT);
-    /// Returns indices of four resulting triangles
-    std::stack<TriInd> insertVertexOnEdge(VertInd v, TriInd iT1, TriInd iT2);
+    /// Leaves indices of three resulting triangles in m_triStack
+    void insertVertexInsideTriangle(VertInd v, TriInd iT);
+    /// Leaves indices of four resulting triangles in m_triStack
+    void insertVertexOnEdge(VertInd v, TriInd iT1, TriInd iT2);
     array<TriInd, 2> trianglesAt(const V2d<T>& pos) const;
     array<TriInd, 2>
     walkingSearchTrianglesAt(const V2d<T>& pos, VertInd startVertex) const;
@@ -516,6 +553,12 @@ private:
      * @removedTriangles indices of triangles to remove
      */
     void finalizeTriangulation(const TriIndUSet& removedTriangles);
+    /// Same for the triangles flagged in m_removedTris
+    void finalizeTriangulation();
+    /// Flag the given triangles in m_removedTris
+    void markRemovedTriangles(const TriIndUSet& removedTriangles);
+    /// Remove the triangles flagged in m_removedTris
+    void removeMarkedTriangles();
     TriIndUSet growToBoundary(std::stack<TriInd> seeds) const;
     void fixEdge(const Edge& edge, BoundaryOverlapCount overlaps);
     void fixEdge(const Edge& edge);
@@ -542,16 +585,30 @@ private:
      * blocked by constraint edges. Triangles behind constraint edges are
      * recorded as seeds of next layer and returned from the function.
      *
-     * @param seeds indices of seed triangles
+     * @param[in, out] seeds indices of seed triangles, used as a stack and
+     * left empty
      * @param layerDepth current layer's depth to mark triangles with
      * @param[in, out] triDepths depths of triangles
-     * @return triangles of the deeper layers that are adjacent to the peeled
-     * layer. To be used as seeds when peeling deeper layers.
+     * @param[out] behindBoundary triangles of the deeper layers that are
+     * adjacent to the peeled layer. To be used as seeds when peeling deeper
+     * layers.
      */
-    unordered_map<TriInd, LayerDepth> peelLayer(
-        std::stack<TriInd> seeds,
+    void peelLayer(
+        TriIndVec& seeds,
         LayerDepth layerDepth,
-        std::vector<LayerDepth>& triDepths) const;
+        std::vector<LayerDepth>& triDepths,
+        TriIndLayerDepthMap& behindBoundary) const;
+    /// Buffers of depth peeling, kept by the triangulation so finalizing
+    /// many triangulations in turn does not allocate them every time
+    struct DepthPeeling
+    {
+        TriIndVec seeds;
+        TriIndLayerDepthMap behindBoundary;
+        std::vector<TriIndUSet> seedsByDepth;
+    };
+    void calculateTriangleDepths(
+        std::vector<LayerDepth>& triDepths,
+        DepthPeeling& peeling) const;
 
     void insertVertices_AsProvided(VertInd superGeomVertCount);
     void insertVertices_Randomized(VertInd superGeomVertCount);
@@ -577,6 +634,30 @@ private:
     IntersectingConstraintEdges::Enum m_intersectingEdgesStrategy;
     T m_minDistToConstraintEdge;
     TriIndVec m_vertTris; /// one triangle adjacent to each vertex
+    /// triangles to check for edge flips after inserting a vertex, re-used
+    /// between insertions
+    TriIndVec m_triStack;
+    // Working buffers of edge insertion and finalization. Like m_triStack they
+    // are only cleared between uses, so a triangulation that is clear()-ed and
+    // filled again re-uses their allocations.
+    std::vector<TriangulatePseudopolygonTask> m_tppIterations;
+    EdgeVec m_remainingEdges;
+    std::vector<TriInd> m_intersected;
+    std::vector<VertInd> m_polyL, m_polyR;
+    std::vector<TriInd> m_outerTrisL, m_outerTrisR;
+    std::vector<VertInd> m_bfsOrder;
+    std::vector<tuple<
+        std::vector<VertInd>::iterator,
+        std::vector<VertInd>::iterator,
+        V2d<T>,
+        V2d<T>,
+        VertInd> >
+        m_bfsQueue;
+    std::vector<char> m_removedTris; /// flags triangles to remove
+    TriIndVec m_triIndMap;
+    std::vector<LayerDepth> m_triDepths;
+    DepthPeeling m_depthPeeling;
+    EdgeUSet m_remappedEdges;
 };
 
 /// @}
@@ -695,8 +776,9 @@ void Triangulation<T, TNearPointLocator>::insertEdges(
     TGetEdgeVertexEnd getEnd)
 {
     // state shared between different runs for performance gains
-    std::vector<TriangulatePseudopolygonTask> tppIterations;
-    EdgeVec remaining;
+    std::vector<TriangulatePseudopolygonTask>& tppIterations = m_tppIterations;
+    EdgeVec& remaining = m_remainingEdges;
+    tppIterations.clear();
     if(isFinalized())
     {
         throw std::runtime_error(
@@ -97,34 +97,42 @@ void Triangulation<T, TNearPointLocator>::eraseDummies()
 {
     if(m_dummyTris.empty())
         return;
-    const TriIndUSet dummySet(m_dummyTris.begin(), m_dummyTris.end());
-    TriIndUMap triIndMap;
-    triIndMap[noNeighbor] = noNeighbor;
-    for(TriInd iT(0), iTnew(0); iT < TriInd(triangles.size()); ++iT)
+    // old to new triangle indices, noNeighbor for the dummies
+    TriIndVec& triIndMap = m_triIndMap;
+    triIndMap.assign(triangles.size(), TriInd(0));
+    typedef std::vector<TriInd>::const_iterator TriIndCit;
+    for(TriIndCit it = m_dummyTris.begin(); it != m_dummyTris.end(); ++it)
+        triIndMap[*it] = noNeighbor;
+    TriInd iTnew(0);
+    for(TriInd iT(0); iT < TriInd(triangles.size()); ++iT)
     {
-        if(dummySet.count(iT))
+        if(triIndMap[iT] == noNeighbor)
             continue;
         triIndMap[iT] = iTnew;
         triangles[iTnew] = triangles[iT];
         iTnew++;
     }
-    triangles.erase(triangles.end() - dummySet.size(), triangles.end());
+    triangles.erase(triangles.begin() + iTnew, triangles.end());
 
     // remap adjacent triangle indices for vertices
     for(TriIndVec::iterator iT = m_vertTris.begin(); iT != m_vertTris.end();
         ++iT)
     {
-        *iT = triIndMap[*iT];
+        if(*iT != noNeighbor)
+            *iT = triIndMap[*iT];
     }
     // remap neighbor indices for triangles
     for(TriangleVec::iterator t = triangles.begin(); t != triangles.end(); ++t)
     {
         NeighborsArr3& nn = t->neighbors;
         for(NeighborsArr3::iterator iN = nn.begin(); iN != nn.end(); ++iN)
-            *iN = triIndMap[*iN];
+        {
+            if(*iN != noNeighbor)
+                *iN = triIndMap[*iN];
+        }
     }
-    // clear dummy triangles
-    m_dummyTris = std::vector<TriInd>();
+    // clear dummy triangles, keeping the allocation
+    m_dummyTris.clear();
 }
 
 template <typename T, typename TNearPointLocator>
@@ -156,15 +164,13 @@ void Triangulation<T, TNearPointLocator>::eraseOuterTriangles()
 template <typename T, typename TNearPointLocator>
 void Triangulation<T, TNearPointLocator>::eraseOuterTrianglesAndHoles()
 {
-    const std::vector<LayerDepth> triDepths = calculateTriangleDepths();
-    TriIndUSet toErase;
-    toErase.reserve(triangles.size());
+    std::vector<LayerDepth>& triDepths = m_triDepths;
+    calculateTriangleDepths(triDepths, m_depthPeeling);
+    std::vector<char>& toErase = m_removedTris;
+    toErase.resize(triangles.size());
     for(std::size_t iT = 0; iT != triangles.size(); ++iT)
-    {
-        if(triDepths[iT] % 2 == 0)
-            toErase.insert(static_cast<TriInd>(iT));
-    }
-    finalizeTriangulation(toErase);
+        toErase[iT] = triDepths[iT] % 2 == 0;
+    finalizeTriangulation();
 }
 
 /// Remap removing super-triangle: subtract 3 from vertices
@@ -173,23 +179,46 @@ inline Edge RemapNoSuperTriangle(const Edge& e)
     return Edge(VertInd(e.v1() - 3), VertInd(e.v2() - 3));
 }
 
+template <typename T, typename TNearPointLocator>
+void Triangulation<T, TNearPointLocator>::markRemovedTriangles(
+    const TriIndUSet& removedTriangles)
+{
+    m_removedTris.assign(triangles.size(), false);
+    typedef TriIndUSet::const_iterator It;
+    for(It it = removedTriangles.begin(); it != removedTriangles.end(); ++it)
+        m_removedTris[*it] = true;
+}
+
 template <typename T, typename TNearPointLocator>
 void Triangulation<T, TNearPointLocator>::removeTriangles(
     const TriIndUSet& removedTriangles)
 {
     if(removedTriangles.empty())
         return;
-    // remove triangles and calculate triangle index mapping
-    TriIndUMap triIndMap;
-    for(TriInd iT(0), iTnew(0); iT < TriInd(triangles.size()); ++iT)
+    markRemovedTriangles(removedTriangles);
+    removeMarkedTriangles();
+}
+
+template <typename T, typename TNearPointLocator>
+void Triangulation<T, TNearPointLocator>::removeMarkedTriangles()
+{
+    // remove triangles and calculate triangle index mapping, noNeighbor for
+    // the removed ones
+    TriIndVec& triIndMap = m_triIndMap;
+    triIndMap.resize(triangles.size());
+    TriInd iTnew(0);
+    for(TriInd iT(0); iT < TriInd(triangles.size()); ++iT)
     {
-        if(removedTriangles.count(iT))
+        if(m_removedTris[iT])
+        {
+            triIndMap[iT] = noNeighbor;
             continue;
+        }
         triIndMap[iT] = iTnew;
         triangles[iTnew] = triangles[iT];
         iTnew++;
     }
-    triangles.erase(triangles.end() - removedTriangles.size(), triangles.end());
+    triangles.erase(triangles.begin() + iTnew, triangles.end());
     // adjust triangles' neighbors
     for(TriInd iT(0); iT < triangles.size(); ++iT)
     {
@@ -198,17 +227,12 @@ void Triangulation<T, TNearPointLocator>::removeTriangles(
         NeighborsArr3& nn = t.neighbors;
         for(NeighborsArr3::iterator n = nn.begin(); n != nn.end(); ++n)
         {
-            if(removedTriangles.count(*n))
-            {
-                *n = noNeighbor;
-            }
-            else if(*n != noNeighbor)
-            {
+            if(*n != noNeighbor)
                 *n = triIndMap[*n];
-            }
         }
     }
 }
+
 template <typename T, typename TNearPointLocator>
 TriIndVec& Triangulation<T, TNearPointLocator>::VertTrisInternal()
 {
@@ -220,24 +244,34 @@ void Triangulation<T, TNearPointLocator>::finalizeTriangulation(
     const TriIndUSet& removedTriangles)
 {
     eraseDummies();
-    m_vertTris = TriIndVec();
+    markRemovedTriangles(removedTriangles);
+    finalizeTriangulation();
+}
+
+template <typename T, typename TNearPointLocator>
+void Triangulation<T, TNearPointLocator>::finalizeTriangulation()
+{
+    eraseDummies();
+    m_vertTris.clear();
     // remove super-triangle
     if(m_superGeomType == SuperGeometryType::SuperTriangle)
     {
         vertices.erase(vertices.begin(), vertices.begin() + 3);
         // Edge re-mapping
         { // fixed edges
-            EdgeUSet updatedFixedEdges;
+            EdgeUSet& updatedFixedEdges = m_remappedEdges;
+            updatedFixedEdges.clear();
+            updatedFixedEdges.reserve(fixedEdges.size());
             typedef CDT::EdgeUSet::const_iterator It;
             for(It e = fixedEdges.begin(); e != fixedEdges.end(); ++e)
             {
                 updatedFixedEdges.insert(RemapNoSuperTriangle(*e));
             }
-            fixedEdges = updatedFixedEdges;
+            fixedEdges.swap(updatedFixedEdges);
         }
         { // overlap count
-            unordered_map<Edge, BoundaryOverlapCount> updatedOverlapCount;
-            typedef unordered_map<Edge, BoundaryOverlapCount>::const_iterator
+            EdgeOverlapCountMap updatedOverlapCount;
+            typedef EdgeOverlapCountMap::const_iterator
                 It;
             for(It it = overlapCount.begin(); it != overlapCount.end(); ++it)
             {
@@ -247,8 +281,8 @@ void Triangulation<T, TNearPointLocator>::finalizeTriangulation(
             overlapCount = updatedOverlapCount;
         }
         { // split edges mapping
-            unordered_map<Edge, EdgeVec> updatedPieceToOriginals;
-            typedef unordered_map<Edge, EdgeVec>::const_iterator It;
+            EdgeEdgesMap updatedPieceToOriginals;
+            typedef EdgeEdgesMap::const_iterator It;
             for(It it = pieceToOriginals.begin(); it != pieceToOriginals.end();
                 ++it)
             {
@@ -265,7 +299,7 @@ void Triangulation<T, TNearPointLocator>::finalizeTriangulation(
         }
     }
     // remove other triangles
-    removeTriangles(removedTriangles);
+    removeMarkedTriangles();
     // adjust triangle vertices: account for removed super-triangle
     if(m_superGeomType == SuperGeometryType::SuperTriangle)
     {
@@ -289,6 +323,42 @@ void Triangulation<T, TNearPointLocator>::initializedWithCustomSuperGeometry()
     m_superGeomType = SuperGeometryType::Custom;
 }
 
+template <typename T, typename TNearPointLocator>
+void Triangulation<T, TNearPointLocator>::clear()
+{
+    vertices.clear();
+    triangles.clear();
+    fixedEdges.clear();
+    overlapCount.clear();
+    pieceToOriginals.clear();
+    m_dummyTris.clear();
+    m_nearPtLocator.clear();
+    m_nTargetVerts = detail::defaults::nTargetVerts;
+    m_superGeomType = detail::defaults::superGeomType;
+    m_vertTris.clear();
+    m_triStack.clear();
+}
+
+template <typename T, typename TNearPointLocator>
+void Triangulation<T, TNearPointLocator>::reserve(
+    const std::size_t nVertices,
+    const std::size_t nTriangles,
+    const std::size_t nFixedEdges)
+{
+    vertices.reserve(nVertices + 3);
+    m_vertTris.reserve(nVertices + 3);
+    triangles.reserve(nTriangles);
+    fixedEdges.reserve(nFixedEdges);
+}
+
+template <typename T, typename TNearPointLocator>
+void Triangulation<T, TNearPointLocator>::initializedWithSuperTriangle()
+{
+    m_nearPtLocator.clear(); // re-built on next insertion
+    m_nTargetVerts = 3;
+    m_superGeomType = SuperGeometryType::SuperTriangle;
+}
+
 template <typename T, typename TNearPointLocator>
 TriIndUSet Triangulation<T, TNearPointLocator>::growToBoundary(
     std::stack<TriInd> seeds) const
@@ -519,16 +589,21 @@ void Triangulation<T, TNearPointLocator>::insertEdgeIteration(
         return;
     }
     Triangle t = triangles[iT];
-    std::vector<TriInd> intersected(1, iT);
-    std::vector<VertInd> polyL, polyR;
-    std::vector<TriInd> outerTrisL, outerTrisR;
-    polyL.reserve(2);
+    std::vector<TriInd>& intersected = m_intersected;
+    std::vector<VertInd>& polyL = m_polyL;
+    std::vector<VertInd>& polyR = m_polyR;
+    std::vector<TriInd>& outerTrisL = m_outerTrisL;
+    std::vector<TriInd>& outerTrisR = m_outerTrisR;
+    intersected.assign(1, iT);
+    polyL.clear();
     polyL.push_back(iA);
     polyL.push_back(iVL);
+    outerTrisL.clear();
     outerTrisL.push_back(edgeNeighbor(t, iA, iVL));
-    polyR.reserve(2);
+    polyR.clear();
     polyR.push_back(iA);
     polyR.push_back(iVR);
+    outerTrisR.clear();
     outerTrisR.push_back(edgeNeighbor(t, iA, iVR));
     removeAdjacentTriangle(iVL);
     removeAdjacentTriangle(iVR);
@@ -560,7 +635,7 @@ void Triangulation<T, TNearPointLocator>::insertEdgeIteration(
             fixEdge(half2, overlaps);
             // maintain piece-to-original mapping
             EdgeVec newOriginals(1, splitEdge);
-            const unordered_map<Edge, EdgeVec>::const_iterator originalsIt =
+            const EdgeEdgesMap::const_iterator originalsIt =
                 pieceToOriginals.find(splitEdge);
             if(originalsIt != pieceToOriginals.end())
             { // edge being split was split before: pass-through originals
@@ -578,10 +653,9 @@ void Triangulation<T, TNearPointLocator>::insertEdgeIteration(
             const V2d<T> newV = detail::intersectionPosition(
                 vertices[iA], vertices[iB], vertices[iVL], vertices[iVR]);
             addNewVertex(newV, noNeighbor);
-            std::stack<TriInd> triStack =
-                insertVertexOnEdge(iNewVert, iT, iTopo);
+            insertVertexOnEdge(iNewVert, iT, iTopo);
             tryAddVertexToLocator(iNewVert);
-            ensureDelaunayByEdgeFlips(newV, iNewVert, triStack);
+            ensureDelaunayByEdgeFlips(newV, iNewVert, m_triStack);
             // TODO: is it's possible to re-use pseudo-polygons
             //  for inserting [iA, iNewVert] edge half?
             remaining.push_back(Edge(iA, iNewVert));
@@ -758,7 +832,7 @@ void Triangulation<T, TNearPointLocator>::conformToEdgeIteration(
             const Edge half1(iVleft, iNewVert);
             const Edge half2(iNewVert, iVright);
 
-            const unordered_map<Edge, BoundaryOverlapCount>::const_iterator
+            const EdgeOverlapCountMap::const_iterator
                 splitEdgeOverlapsIt = overlapCount.find(splitEdge);
             const BoundaryOverlapCount splitEdgeOverlaps =
                 splitEdgeOverlapsIt != overlapCount.end()
@@ -780,7 +854,7 @@ void Triangulation<T, TNearPointLocator>::conformToEdgeIteration(
             }
             // maintain piece-to-original mapping
             EdgeVec newOriginals(1, splitEdge);
-            const unordered_map<Edge, EdgeVec>::const_iterator originalsIt =
+            const EdgeEdgesMap::const_iterator originalsIt =
                 pieceToOriginals.find(splitEdge);
             if(originalsIt != pieceToOriginals.end())
             { // edge being split was split before: pass-through originals
@@ -797,10 +871,9 @@ void Triangulation<T, TNearPointLocator>::conformToEdgeIteration(
                 vertices[iVleft],
                 vertices[iVright]);
             addNewVertex(newV, noNeighbor);
-            std::stack<TriInd> triStack =
-                insertVertexOnEdge(iNewVert, iT, iTopo);
+            insertVertexOnEdge(iNewVert, iT, iTopo);
             tryAddVertexToLocator(iNewVert);
-            ensureDelaunayByEdgeFlips(newV, iNewVert, triStack);
+            ensureDelaunayByEdgeFlips(newV, iNewVert, m_triStack);
 #ifdef CDT_CXX11_IS_SUPPORTED
             remaining.emplace_back(Edge(iNewVert, iB), originals, overlaps);
             remaining.emplace_back(Edge(iA, iNewVert), originals, overlaps);
@@ -871,7 +944,7 @@ void Triangulation<T, TNearPointLocator>::conformToEdgeIteration(
         fixedEdges.erase(flippedFixedEdge);
 
         BoundaryOverlapCount prevOverlaps = 0;
-        const unordered_map<Edge, BoundaryOverlapCount>::const_iterator
+        const EdgeOverlapCountMap::const_iterator
             overlapsIt = overlapCount.find(flippedFixedEdge);
         if(overlapsIt != overlapCount.end())
         {
@@ -880,7 +953,7 @@ void Triangulation<T, TNearPointLocator>::conformToEdgeIteration(
         }
         // override overlapping boundaries count when re-inserting an edge
         EdgeVec prevOriginals(1, flippedFixedEdge);
-        const unordered_map<Edge, EdgeVec>::const_iterator originalsIt =
+        const EdgeEdgesMap::const_iterator originalsIt =
             pieceToOriginals.find(flippedFixedEdge);
         if(originalsIt != pieceToOriginals.end())
         {
@@ -1031,19 +1104,22 @@ Triangulation<T, TNearPointLocator>::insertVertex_FlipFixedEdges(
 {
     std::vector<Edge> flippedFixedEdges;
 
+    tryInitNearestPointLocator();
     const V2d<T>& v1 = vertices[iV1];
     const VertInd startVertex = m_nearPtLocator.nearPoint(v1, vertices);
     array<TriInd, 2> trisAt = walkingSearchTrianglesAt(v1, startVertex);
-    std::stack<TriInd> triStack =
-        trisAt[1] == noNeighbor ? insertVertexInsideTriangle(iV1, trisAt[0])
-                                : insertVertexOnEdge(iV1, trisAt[0], trisAt[1]);
+    if(trisAt[1] == noNeighbor)
+        insertVertexInsideTriangle(iV1, trisAt[0]);
+    else
+        insertVertexOnEdge(iV1, trisAt[0], trisAt[1]);
 
+    TriIndVec& triStack = m_triStack;
     TriInd iTopo, n1, n2, n3, n4;
     VertInd iV2, iV3, iV4;
     while(!triStack.empty())
     {
-        const TriInd iT = triStack.top();
-        triStack.pop();
+        const TriInd iT = triStack.back();
+        triStack.pop_back();
 
         edgeFlipInfo(iT, iV1, iTopo, iV2, iV3, iV4, n1, n2, n3, n4);
         if(iTopo != noNeighbor && isFlipNeeded(v1, iV1, iV2, iV3, iV4))
@@ -1056,9 +1132,10 @@ Triangulation<T, TNearPointLocator>::insertVertex_FlipFixedEdges(
                 flippedFixedEdges.push_back(flippedEdge);
             }
 
+            CDT_COUNT(cdt_flips, 1);
             flipEdge(iT, iTopo, iV1, iV2, iV3, iV4, n1, n2, n3, n4);
-            triStack.push(iT);
-            triStack.push(iTopo);
+            triStack.push_back(iT);
+            triStack.push_back(iTopo);
         }
     }
 
@@ -1073,11 +1150,11 @@ void Triangulation<T, TNearPointLocator>::insertVertex(
 {
     const V2d<T>& v = vertices[iVert];
     const array<TriInd, 2> trisAt = walkingSearchTrianglesAt(v, walkStart);
-    std::stack<TriInd> triStack =
-        trisAt[1] == noNeighbor
-            ? insertVertexInsideTriangle(iVert, trisAt[0])
-            : insertVertexOnEdge(iVert, trisAt[0], trisAt[1]);
-    ensureDelaunayByEdgeFlips(v, iVert, triStack);
+    if(trisAt[1] == noNeighbor)
+        insertVertexInsideTriangle(iVert, trisAt[0]);
+    else
+        insertVertexOnEdge(iVert, trisAt[0], trisAt[1]);
+    ensureDelaunayByEdgeFlips(v, iVert, m_triStack);
 }
 
 template <typename T, typename TNearPointLocator>
@@ -1093,21 +1170,22 @@ template <typename T, typename TNearPointLocator>
 void Triangulation<T, TNearPointLocator>::ensureDelaunayByEdgeFlips(
     const V2d<T>& v1,
     const VertInd iV1,
-    std::stack<TriInd>& triStack)
+    TriIndVec& triStack)
 {
     TriInd iTopo, n1, n2, n3, n4;
     VertInd iV2, iV3, iV4;
     while(!triStack.empty())
     {
-        const TriInd iT = triStack.top();
-        triStack.pop();
+        const TriInd iT = triStack.back();
+        triStack.pop_back();
 
         edgeFlipInfo(iT, iV1, iTopo, iV2, iV3, iV4, n1, n2, n3, n4);
         if(iTopo != noNeighbor && isFlipNeeded(v1, iV1, iV2, iV3, iV4))
         {
+            CDT_COUNT(cdt_flips, 1);
             flipEdge(iT, iTopo, iV1, iV2, iV3, iV4, n1, n2, n3, n4);
-            triStack.push(iT);
-            triStack.push(iTopo);
+            triStack.push_back(iT);
+            triStack.push_back(iTopo);
         }
     }
 }
@@ -1325,8 +1403,7 @@ void Triangulation<T, TNearPointLocator>::flipEdge(
  *                     n1
  */
 template <typename T, typename TNearPointLocator>
-std::stack<TriInd>
-Triangulation<T, TNearPointLocator>::insertVertexInsideTriangle(
+void Triangulation<T, TNearPointLocator>::insertVertexInsideTriangle(
     VertInd v,
     TriInd iT)
 {
@@ -1350,12 +1427,11 @@ Triangulation<T, TNearPointLocator>::insertVertexInsideTriangle(
     // change triangle neighbor's neighbors to new triangles
     changeNeighbor(n2, iT, iNewT1);
     changeNeighbor(n3, iT, iNewT2);
-    // return newly added triangles
-    std::stack<TriInd> newTriangles;
-    newTriangles.push(iT);
-    newTriangles.push(iNewT1);
-    newTriangles.push(iNewT2);
-    return newTriangles;
+    // newly added triangles are checked for edge flips
+    m_triStack.clear();
+    m_triStack.push_back(iT);
+    m_triStack.push_back(iNewT1);
+    m_triStack.push_back(iNewT2);
 }
 
 /* Inserting a point on the edge between two triangles
@@ -1372,7 +1448,7 @@ Triangulation<T, TNearPointLocator>::insertVertexInsideTriangle(
  *   T2 (bottom)      v3
  */
 template <typename T, typename TNearPointLocator>
-std::stack<TriInd> Triangulation<T, TNearPointLocator>::insertVertexOnEdge(
+void Triangulation<T, TNearPointLocator>::insertVertexOnEdge(
     VertInd v,
     TriInd iT1,
     TriInd iT2)
@@ -1404,13 +1480,12 @@ std::stack<TriInd> Triangulation<T, TNearPointLocator>::insertVertexOnEdge(
     // adjust neighboring triangles and vertices
     changeNeighbor(n4, iT1, iTnew1);
     changeNeighbor(n3, iT2, iTnew2);
-    // return newly added triangles
-    std::stack<TriInd> newTriangles;
-    newTriangles.push(iT1);
-    newTriangles.push(iTnew2);
-    newTriangles.push(iT2);
-    newTriangles.push(iTnew1);
-    return newTriangles;
+    // newly added triangles are checked for edge flips
+    m_triStack.clear();
+    m_triStack.push_back(iT1);
+    m_triStack.push_back(iTnew2);
+    m_triStack.push_back(iT2);
+    m_triStack.push_back(iTnew1);
 }
 
 template <typename T, typename TNearPointLocator>
@@ -1460,6 +1535,7 @@ TriInd Triangulation<T, TNearPointLocator>::walkTriangles(
             const TriInd iN = t.neighbors[i];
             if(edgeCheck == PtLineLocation::Right && iN != noNeighbor)
             {
+                CDT_COUNT(cdt_walk_steps, 1);
                 found = false;
                 currTri = t.neighbors[i];
                 break;
@@ -1585,6 +1661,7 @@ void Triangulation<T, TNearPointLocator>::triangulatePseudopolygon(
     std::vector<TriangulatePseudopolygonTask>& iterations)
 {
     assert(poly.size() > 2);
+    CDT_COUNT(cdt_pseudopolygons, 1);
     // note: uses interation instead of recursion to avoid stack overflows
     iterations.clear();
     iterations.push_back(make_tuple(
@@ -1706,17 +1783,19 @@ bool Triangulation<T, TNearPointLocator>::isFinalized() const
 }
 
 template <typename T, typename TNearPointLocator>
-unordered_map<TriInd, LayerDepth>
-Triangulation<T, TNearPointLocator>::peelLayer(
-    std::stack<TriInd> seeds,
+void Triangulation<T, TNearPointLocator>::peelLayer(
+    TriIndVec& seeds,
     const LayerDepth layerDepth,
-    std::vector<LayerDepth>& triDepths) const
+    std::vector<LayerDepth>& triDepths,
+    TriIndLayerDepthMap& behindBoundary) const
 {
-    unordered_map<TriInd, LayerDepth> behindBoundary;
+    // every triangle behind the boundary is across a different fixed edge
+    behindBoundary.clear();
+    behindBoundary.reserve(fixedEdges.size());
     while(!seeds.empty())
     {
-        const TriInd iT = seeds.top();
-        seeds.pop();
+        const TriInd iT = seeds.back();
+        seeds.pop_back();
         triDepths[iT] = std::min(triDepths[iT], layerDepth);
         behindBoundary.erase(iT);
         const Triangle& t = triangles[iT];
@@ -1728,7 +1807,7 @@ Triangulation<T, TNearPointLocator>::peelLayer(
                 continue;
             if(fixedEdges.count(opEdge))
             {
-                const unordered_map<Edge, LayerDepth>::const_iterator cit =
+                const EdgeOverlapCountMap::const_iterator cit =
                     overlapCount.find(opEdge);
                 const LayerDepth triDepth = cit == overlapCount.end()
                                                 ? layerDepth + 1
@@ -1736,42 +1815,59 @@ Triangulation<T, TNearPointLocator>::peelLayer(
                 behindBoundary[iN] = triDepth;
                 continue;
             }
-            seeds.push(iN);
+            seeds.push_back(iN);
         }
     }
-    return behindBoundary;
 }
 
 template <typename T, typename TNearPointLocator>
 std::vector<LayerDepth>
 Triangulation<T, TNearPointLocator>::calculateTriangleDepths() const
 {
-    std::vector<LayerDepth> triDepths(
-        triangles.size(), std::numeric_limits<LayerDepth>::max());
-    std::stack<TriInd> seeds(TriDeque(1, m_vertTris[0]));
+    std::vector<LayerDepth> triDepths;
+    DepthPeeling peeling;
+    calculateTriangleDepths(triDepths, peeling);
+    return triDepths;
+}
+
+template <typename T, typename TNearPointLocator>
+void Triangulation<T, TNearPointLocator>::calculateTriangleDepths(
+    std::vector<LayerDepth>& triDepths,
+    DepthPeeling& peeling) const
+{
+    triDepths.assign(triangles.size(), std::numeric_limits<LayerDepth>::max());
+    TriIndVec& seeds = peeling.seeds;
+    seeds.assign(1, m_vertTris[0]);
     LayerDepth layerDepth = 0;
     LayerDepth deepestSeedDepth = 0;
 
-    unordered_map<LayerDepth, TriIndUSet> seedsByDepth;
+    // seeds of the layers deeper than the current one, by depth
+    std::vector<TriIndUSet>& seedsByDepth = peeling.seedsByDepth;
+    for(std::size_t i = 0; i < seedsByDepth.size(); ++i)
+    {
+        seedsByDepth[i].clear();
+        seedsByDepth[i].reserve(fixedEdges.size());
+    }
     do
     {
-        const unordered_map<TriInd, LayerDepth>& newSeeds =
-            peelLayer(seeds, layerDepth, triDepths);
+        const TriIndLayerDepthMap& newSeeds = peeling.behindBoundary;
+        peelLayer(seeds, layerDepth, triDepths, peeling.behindBoundary);
 
-        seedsByDepth.erase(layerDepth);
-        typedef unordered_map<TriInd, LayerDepth>::const_iterator Iter;
+        typedef TriIndLayerDepthMap::const_iterator Iter;
         for(Iter it = newSeeds.begin(); it != newSeeds.end(); ++it)
         {
             deepestSeedDepth = std::max(deepestSeedDepth, it->second);
+            if(seedsByDepth.size() <= it->second)
+                seedsByDepth.resize(it->second + 1);
             seedsByDepth[it->second].insert(it->first);
         }
-        const TriIndUSet& nextLayerSeeds = seedsByDepth[layerDepth + 1];
-        seeds = std::stack<TriInd>(
-            TriDeque(nextLayerSeeds.begin(), nextLayerSeeds.end()));
+        if(seedsByDepth.size() <= std::size_t(layerDepth) + 1)
+            seedsByDepth.resize(layerDepth + 2);
+        TriIndUSet& nextLayerSeeds = seedsByDepth[layerDepth + 1];
+        seeds.assign(nextLayerSeeds.begin(), nextLayerSeeds.end());
+        nextLayerSeeds.clear();
         ++layerDepth;
     } while(!seeds.empty() || deepestSeedDepth > layerDepth);
-
-    return triDepths;
 }
 
 template <typename T, typename TNearPointLocator>
@@ -1832,12 +1928,14 @@ inline std::size_t maxQueueLengthBFSKDTree(const std::size_t vertexCount)
                : nodesInLastFilledLayer;
 }
 
+/// Queue of fixed capacity in a ring buffer owned by the caller, so the
+/// buffer's allocation can be re-used by the next queue
 template <typename T>
 class FixedCapacityQueue
 {
 public:
-    FixedCapacityQueue(const std::size_t capacity)
-        : m_vec(capacity)
+    FixedCapacityQueue(std::vector<T>& buffer, const std::size_t capacity)
+        : m_vec((buffer.resize(capacity), buffer))
         , m_front(m_vec.begin())
         , m_back(m_vec.begin())
         , m_size(0)
@@ -1879,7 +1977,7 @@ public:
     }
 #endif
 private:
-    std::vector<T> m_vec;
+    std::vector<T>& m_vec;
     typename std::vector<T>::iterator m_front;
     typename std::vector<T>::iterator m_back;
     std::size_t m_size;
@@ -1921,12 +2019,13 @@ void Triangulation<T, TNearPointLocator>::insertVertices_KDTreeBFS(
 {
     // calculate original indices
     std::size_t vertexCount = vertices.size() - superGeomVertCount;
-    std::vector<VertInd> ii(vertexCount);
+    std::vector<VertInd>& ii = m_bfsOrder;
+    ii.resize(vertexCount);
     detail::iota(ii.begin(), ii.end(), superGeomVertCount);
 
     typedef std::vector<VertInd>::iterator It;
     detail::FixedCapacityQueue<tuple<It, It, V2d<T>, V2d<T>, VertInd> > queue(
-        detail::maxQueueLengthBFSKDTree(vertexCount));
+        m_bfsQueue, detail::maxQueueLengthBFSKDTree(vertexCount));
     queue.push(make_tuple(ii.begin(), ii.end(), boxMin, boxMax, VertInd(0)));
 
     It first, last;
@@ -35,6 +35,11 @@
 
 //@reference: https://www.cs.cmu.edu/~quake/robust.html
 
+// Event counting hook (see counters.h); does nothing unless defined before this header
+#ifndef CDT_COUNT
+#define CDT_COUNT(counter, n) ((void)0)
+#endif
+
 namespace  predicates {
 	//@brief: geometric predicates using arbitrary precision arithmetic 
 	//@note : these are provided primarily for illustrative purposes and adaptive routines should be preferred
@@ -624,6 +629,7 @@ namespace detail {
 			const T detsum = std::abs(detleft + detright);
 			T errbound = Constants<T>::ccwerrboundA * detsum;
 			if(std::abs(det) >= std::abs(errbound)) return det;
+			CDT_COUNT(cdt_predicate_fallbacks, 1);
 
 			const detail::Expansion<T, 4> B = detail::ExpansionBase<T>::TwoTwoDiff(acx, bcy, acy, bcx);
 			det = B.estimate();
@@ -670,6 +676,7 @@ namespace detail {
 			                  + (std::abs(adxbdy) + std::abs(bdxady)) * clift;
 			T errbound = Constants<T>::iccerrboundA * permanent;
 			if(std::abs(det) >= std::abs(errbound)) return det;
+			CDT_COUNT(cdt_predicate_fallbacks, 1);
 
 			const detail::Expansion<T, 4> bc = detail::ExpansionBase<T>::TwoTwoDiff(bdx, cdy, cdx, bdy);
 			const detail::Expansion<T, 4> ca = detail::ExpansionBase<T>::TwoTwoDiff(cdx, ady, adx, cdy);
@@ -0,0 +1,56 @@
+//
+// Reading GPPC octile .map files.
+//
+
+#ifndef STARTKIT_LOADMAP_H
+#define STARTKIT_LOADMAP_H
+#include <cstdio>
+#include <cctype>
+#include <vector>
+#include "trace.h"
+
+// in map, 1: traversable, 0: obstacle
+void LoadMap(const char *fname, std::vector<bool> &map, int &width, int &height)
+{
+    TRACE_SCOPE("LoadMap");
+    FILE *f;
+    f = std::fopen(fname, "r");
+    if (f)
+    {
+        std::fscanf(f, "type octile\nheight %d\nwidth %d\nmap\n", &height, &width);
+        map.resize(height*width);
+        for (int y = 0; y < height; y++)
+        {
+            for (int x = 0; x < width; x++)
+            {
+                char c;
+                do {
+                    std::fscanf(f, "%c", &c);
+                } while (std::isspace(c));
+                map[y*width+x] = (c == '.' || c == 'G' || c == 'S');
+            }
+        }
+        std::fclose(f);
+    }
+}
+
+// Cell sides between a traversable cell and an obstacle or the map border: the length of the obstacle
+// boundary the converters trace.
+long long CountObstacleEdges(const std::vector<bool> &map, int width, int height)
+{
+    long long edges = 0;
+    for (int y = 0; y < height; y++)
+    {
+        for (int x = 0; x < width; x++)
+        {
+            if (!map[(size_t)y*width+x]) continue;
+            edges += x == 0 || !map[(size_t)y*width+x-1];
+            edges += x == width-1 || !map[(size_t)y*width+x+1];
+            edges += y == 0 || !map[(size_t)(y-1)*width+x];
+            edges += y == height-1 || !map[(size_t)(y+1)*width+x];
+        }
+    }
+    return edges;
+}
+
+#endif //STARTKIT_LOADMAP_H
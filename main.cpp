@@ -10,12 +10,22 @@
 #include <cmath>
 #include <iostream>
 #include <fstream>
+#include <sstream>
 #include <iomanip>
 #include <vector>
+#include <filesystem>
 #include "mesh2merged.h"
 #include "grid2poly.h"
 #include "poly2mesh.h"
 #include "grid2rect.h"
+#include "meshverify.h"
+#include "meshsearch.h"
+#include "stats.h"
+#include "trace.h"
+#include "counters.h"
+#include "loadmap.h"
+#include "cache.h"
+#include "server.h"
 
 std::string mapfile, outputfile, flag;
 std::vector<bool> mapData;
@@ -23,6 +33,18 @@ int width, height;
 bool grid2REC   = false;
 bool grid2CDT   = false;
 bool grid2MCDT = false;
+bool directCDT = false;
+bool verifyMesh = false;
+bool searchMesh = false;
+bool serveMode = false;
+std::string scenariofile;
+meshsearch::Search searchKind = meshsearch::POLYANYA;
+meshverify::Level validation = meshverify::OFF;
+bool printStats = false;
+std::string statsfile;
+std::string tracefile;
+std::string cachedir;
+bool printCacheStats = false;
 
 
 std::string removeFileExtension(const std::string& filename) {
@@ -38,28 +60,312 @@ std::string removeFileExtension(const std::string& filename) {
     return filename;
 }
 
+bool parse_option(const std::string& option) {
+    if (option == "--direct") directCDT = true;
+    else if (option.rfind("--threads=", 0) == 0) poly2mesh::num_threads = mesh2merged::num_threads = std::atoi(option.c_str() + 10);
+    else if (option.rfind("--strips=", 0) == 0) poly2mesh::strips = std::atoi(option.c_str() + 9);
+    else if (option == "--cdt=library") poly2mesh::triangulator = poly2mesh::LIBRARY;
+    else if (option == "--cdt=rectilinear") poly2mesh::triangulator = poly2mesh::RECTILINEAR;
+    else if (option == "--cdt=check") poly2mesh::triangulator = poly2mesh::CHECK;
+    else if (option == "--merge=smart") mesh2merged::merge_strategy = mesh2merged::SMART;
+    else if (option == "--merge=matching") mesh2merged::merge_strategy = mesh2merged::MATCHING;
+    else if (option == "--merge-priority=area") mesh2merged::merge_priority = mesh2merged::AREA;
+    else if (option == "--merge-priority=search") mesh2merged::merge_priority = mesh2merged::SEARCH_COST;
+    else if (option.rfind("--scen=", 0) == 0) scenariofile = option.substr(7);
+    else if (option == "--search=polyanya") searchKind = meshsearch::POLYANYA;
+    else if (option == "--search=corridor") searchKind = meshsearch::CORRIDOR;
+    else if (option == "--refine") mesh2merged::refine = true;
+    else if (option == "--stats") printStats = true;
+    else if (option.rfind("--stats=", 0) == 0) {
+        printStats = true;
+        statsfile = option.substr(8);
+    }
+    else if (option.rfind("--trace=", 0) == 0) tracefile = option.substr(8);
+    else if (option.rfind("--cache=", 0) == 0) cachedir = option.substr(8);
+    else if (option.rfind("--cache-size=", 0) == 0) meshcache::max_bytes = (long long)(std::atof(option.c_str() + 13) * 1048576);
+    else if (option == "--cache-stats") printCacheStats = true;
+    else if (option == "--cache-hardlink") meshcache::hardlink = true;
+    else if (option.rfind("--merge-time=", 0) == 0) mesh2merged::merge_time_limit = std::atof(option.c_str() + 13);
+    else if (option.rfind("--max-merges=", 0) == 0) mesh2merged::merge_limit = std::atoll(option.c_str() + 13);
+    else if (option == "--validate=off") validation = meshverify::OFF;
+    else if (option == "--validate=sampled") validation = meshverify::SAMPLED;
+    else if (option == "--validate=full") validation = meshverify::FULL;
+    else if (option.rfind("--workers=", 0) == 0) meshserver::num_workers = std::atoi(option.c_str() + 10);
+    else if (option.rfind("--out-root=", 0) == 0) meshserver::out_root = option.substr(11);
+    else return false;
+    return true;
+}
+
 bool parse_argv(int argc, char **argv) {
     if (argc < 2) return false;
     flag = std::string(argv[1]);
     if (flag== "-rec") grid2REC =  true;
     else if (flag == "-cdt") grid2CDT = true;
     else if (flag == "-mcdt") grid2MCDT = true;
+    else if (flag == "-verify") {
+        verifyMesh = true;
+        validation = meshverify::FULL;
+    }
+    else if (flag == "-scen") searchMesh = true;
+    else if (flag == "-serve") serveMode = true;
 
 
     if (argc < 3) return false;
     mapfile = std::string(argv[2]);
 
     outputfile = removeFileExtension(mapfile);
+    scenariofile = outputfile + ".map.scen";
+
+    for (int i = 3; i < argc; i++) {
+        if (!parse_option(argv[i])) return false;
+    }
 
     return true;
 }
 
 void print_help(char **argv) {
-    std::printf("Invalid Arguments\nUsage %s <flag> <map>\n", argv[0]);
+    std::printf("Invalid Arguments\nUsage %s <flag> <map> [options]\n", argv[0]);
     std::printf("Flags:\n");
     std::printf("\t-rec : Convert grid map to rectangle mesh\n");
     std::printf("\t-cdt : Convert grid map to CDT mesh\n");
     std::printf("\t-mcdt : Convert grid map to Merged CDT mesh\n");
+    std::printf("\t-verify : Check a .rec, .cdt or .merged-cdt mesh given in place of the map\n");
+    std::printf("\t-serve : Listen on the Unix socket given in place of the map for conversion requests (see server.h)\n");
+    std::printf("\t-scen : Search a mesh given in place of the map for every query of its scenario file\n");
+    std::printf("Options:\n");
+    std::printf("\t--direct : Feed constraint edges straight from the grid to the CDT, without writing the .poly file\n");
+    std::printf("\t--threads=N : Number of worker threads (default: one per hardware thread)\n");
+    std::printf("\t--strips=N : Vertical strips the CDT library triangulates large components in, in parallel (default: one per thread)\n");
+    std::printf("\t--cdt=library|rectilinear|check : Triangulator for the CDT (default: rectilinear, falling back to library)\n");
+    std::printf("\t--merge=smart|matching : Merge the heaviest pair at a time, or a matching of pairs per round in parallel (default: smart)\n");
+    std::printf("\t--merge-priority=area|search : Merge the largest polygons first, or the merges that save the most expected search cost (-mcdt, default: area)\n");
+    std::printf("\t--scen=FILE : Scenario file for -scen (default: the mesh file name with .map.scen)\n");
+    std::printf("\t--search=polyanya|corridor : Optimal any-angle search, or A* through edge midpoints, for -scen (default: polyanya)\n");
+    std::printf("\t--refine : After merging, re-partition small regions where that gives fewer polygons (-mcdt)\n");
+    std::printf("\t--merge-time=S : Stop merging polygons after S seconds and write the partially merged mesh (-mcdt)\n");
+    std::printf("\t--max-merges=N : Stop merging polygons after N merges and write the partially merged mesh (-mcdt)\n");
+    std::printf("\t--validate=off|sampled|full : Check the written meshes (default: off, full for -verify)\n");
+    std::printf("\t--trace=FILE : Write a Chrome trace-event timeline of the conversion to FILE (needs a build with -DSTARTKIT_TRACE=ON)\n");
+    std::printf("\t--cache=DIR : Take the meshes from the cache in DIR when the same grid was converted with the same options before, and add them to it otherwise\n");
+    std::printf("\t--cache-size=MB : Evict the least recently used meshes to keep the cache under MB megabytes (default: 1024)\n");
+    std::printf("\t--cache-stats : Print the cache's size and hit, miss and eviction counts after the run\n");
+    std::printf("\t--cache-hardlink : Hardlink meshes into and out of the cache instead of copying them; a mesh edited in place then changes the cached one too\n");
+    std::printf("\t--workers=N : Worker processes that convert requests in parallel, for -serve (default: 2)\n");
+    std::printf("\t--out-root=DIR : Directory -serve writes meshes under; requests for other paths get an error (default: the working directory)\n");
+    std::printf("\t--stats[=FILE] : Print (or append to FILE) a JSON line with the time and memory of each conversion stage\n");
+}
+
+
+// Everything besides the grid that changes what the converter writes, for the cache key. The thread count
+// is left out, so runs with different --threads share entries. --strips stays in: a lattice map has many
+// cocircular points, and the library may triangulate them differently when it works in other strips.
+std::string cacheOptions() {
+    std::ostringstream options;
+    options << directCDT << ' ' << poly2mesh::triangulator << ' ' << poly2mesh::strips << ' '
+            << mesh2merged::merge_strategy << ' ' << mesh2merged::merge_priority << ' '
+            << mesh2merged::refine << ' ' << mesh2merged::merge_limit;
+    return options.str();
+}
+
+
+// Convert mapData to the meshes selected by the flag, at outputfile with their extensions, and list them
+// in written. Returns false if a written mesh fails --validate.
+bool convertMap(std::vector<std::string>& written) {
+    stats::count("map.cells", (long long)width * height);
+    stats::count("map.traversable_cells", std::count(mapData.begin(), mapData.end(), true));
+    if(printStats){
+        stats::count("map.obstacle_edges", CountObstacleEdges(mapData, width, height));
+    }
+
+    written.clear();
+    if(grid2REC) written.push_back(outputfile+".rec");
+    if(grid2CDT || grid2MCDT) written.push_back(outputfile+".cdt");
+    if(grid2MCDT) written.push_back(outputfile+".merged-cdt");
+
+    // a time limit on merging makes the output depend on how fast the machine is
+    const bool cached = !cachedir.empty() && mesh2merged::merge_time_limit <= 0;
+    std::string cachekey;
+    bool cachehit = false;
+    if(cached){
+        stats::Scope scope("cache.fetch");
+        std::error_code ec;
+        std::filesystem::create_directories(cachedir, ec);
+        cachekey = meshcache::key(flag, cacheOptions(), mapData, width, height);
+        cachehit = meshcache::fetch(cachedir, cachekey, written);
+        stats::count("cache.hit", cachehit);
+    }
+    // with --cache-hardlink a previous output may be a hardlink into the cache, which writing it in place would
+    // change too
+    if(!cachehit){
+        for(const auto& file : written){
+            std::remove(file.c_str());
+        }
+    }
+
+    if(grid2REC && !cachehit){
+       grid2rect::convertgrid2rect(mapData, width, height, outputfile+".rec");
+    }
+    if((grid2CDT || grid2MCDT) && !cachehit){
+        if(directCDT){
+            grid2poly::vpoint vertices;
+            std::vector<std::array<int, 3>> segments;
+            grid2poly::convertGrid2Constraints(mapData, width, height, vertices, segments);
+            poly2mesh::convertConstraints2Mesh(vertices, segments, outputfile+".cdt");
+        }else{
+            grid2poly::convertGrid2Poly(mapData, width, height, outputfile+".poly");
+            poly2mesh::convertPoly2Mesh(outputfile+".poly",outputfile+".cdt",width);
+        }
+    }
+    if(grid2MCDT && !cachehit){
+        mesh2merged::convertMesh2MergedMesh(outputfile+".cdt",outputfile+".merged-cdt");
+    }
+
+    if(validation != meshverify::OFF){
+        stats::Scope scope("verify");
+        for(const auto& file : written){
+            if(!meshverify::verify_file(file, validation, poly2mesh::num_threads)){
+                return false;
+            }
+        }
+    }
+
+    if(cached){
+        stats::Scope scope("cache.store");
+        if(!cachehit){
+            meshcache::store(cachedir, cachekey, written);
+        }
+        meshcache::evict(cachedir, cachekey);
+    }
+    if(printCacheStats && !cachedir.empty()){
+        meshcache::print_totals(cachedir);
+    }
+    return true;
+}
+
+bool convertMap() {
+    std::vector<std::string> written;
+    return convertMap(written);
+}
+
+void writeStats() {
+    counters::add_to_stats();
+    if(statsfile.empty()){
+        stats::write_json(std::cout, mapfile, flag.substr(1));
+    }else{
+        std::ofstream out(statsfile, std::ios::app);
+        stats::write_json(out, mapfile, flag.substr(1));
+    }
+}
+
+// The options a -serve request can change, so that each request starts from the ones the daemon was
+// started with.
+struct Settings {
+    bool directCDT;
+    int threads, strips;
+    poly2mesh::Triangulator triangulator;
+    mesh2merged::MergeStrategy merge_strategy;
+    mesh2merged::MergePriority merge_priority;
+    bool refine;
+    double merge_time_limit;
+    long long merge_limit;
+    meshverify::Level validation;
+    bool printStats;
+    std::string statsfile, cachedir;
+    long long cache_bytes;
+    bool printCacheStats, cache_hardlink;
+
+    static Settings current() {
+        return {::directCDT, poly2mesh::num_threads, poly2mesh::strips, poly2mesh::triangulator,
+                mesh2merged::merge_strategy, mesh2merged::merge_priority, mesh2merged::refine,
+                mesh2merged::merge_time_limit, mesh2merged::merge_limit, ::validation, ::printStats, ::statsfile,
+                ::cachedir, meshcache::max_bytes, ::printCacheStats, meshcache::hardlink};
+    }
+
+    void restore() const {
+        ::directCDT = directCDT;
+        poly2mesh::num_threads = mesh2merged::num_threads = threads;
+        poly2mesh::strips = strips;
+        poly2mesh::triangulator = triangulator;
+        mesh2merged::merge_strategy = merge_strategy;
+        mesh2merged::merge_priority = merge_priority;
+        mesh2merged::refine = refine;
+        mesh2merged::merge_time_limit = merge_time_limit;
+        mesh2merged::merge_limit = merge_limit;
+        ::validation = validation;
+        ::printStats = printStats;
+        ::statsfile = statsfile;
+        ::cachedir = cachedir;
+        meshcache::max_bytes = cache_bytes;
+        ::printCacheStats = printCacheStats;
+        meshcache::hardlink = cache_hardlink;
+    }
+};
+
+// Options that name a file or directory of the daemon, or change the daemon itself, so that a client cannot
+// make it write anywhere.
+bool daemonOption(const std::string& option) {
+    return option.rfind("--stats=", 0) == 0 || option.rfind("--cache", 0) == 0 || option.rfind("--trace=", 0) == 0 ||
+           option.rfind("--workers=", 0) == 0 || option.rfind("--out-root=", 0) == 0 || option.rfind("--scen=", 0) == 0;
+}
+
+// One -serve request, run in a worker process with the converters' state left from the previous one. The
+// stats of a request with --stats (or of every request, if the daemon was started with --stats and no
+// file) go back in the reply.
+bool serveRequest(const Settings& defaults, const meshserver::Request& request, std::vector<std::string>& written,
+                  std::string& statsJson, std::string& error) {
+    defaults.restore();
+    bool replyStats = printStats && statsfile.empty();
+    for(const auto& option : request.options){
+        if(daemonOption(option)){
+            error = "option " + option + " can only be given when the daemon starts";
+            return false;
+        }
+        if(!parse_option(option)){
+            error = "unknown option " + option;
+            return false;
+        }
+        replyStats = replyStats || option == "--stats";
+    }
+    flag = "-" + request.mode;
+    grid2REC = request.mode == "rec";
+    grid2CDT = request.mode == "cdt";
+    grid2MCDT = request.mode == "mcdt";
+    outputfile = request.out;
+    // the CDT path reads back the .poly file it writes, and exits if it cannot
+    const std::filesystem::path outdir = std::filesystem::path(outputfile).parent_path();
+    if(!outdir.empty() && !std::filesystem::is_directory(outdir)){
+        error = "no directory " + outdir.string();
+        return false;
+    }
+    stats::reset();
+    counters::reset();
+    if(request.map.empty()){
+        mapfile = "grid:" + std::to_string(request.width) + "x" + std::to_string(request.height);
+        mapData = request.grid;
+        width = request.width;
+        height = request.height;
+    }else{
+        mapfile = request.map;
+        if(!std::ifstream(mapfile)){
+            error = "cannot read " + mapfile;
+            return false;
+        }
+        stats::Scope scope("load");
+        LoadMap(mapfile.c_str(), mapData, width, height);
+    }
+    if(!convertMap(written)){
+        error = "the mesh failed validation";
+        return false;
+    }
+    if(replyStats){
+        counters::add_to_stats();
+        std::ostringstream out;
+        stats::write_json(out, mapfile, flag.substr(1));
+        statsJson = out.str();
+    }else if(printStats){
+        writeStats();
+    }
+    return true;
 }
 
 
@@ -73,29 +379,6 @@ std::string basename(const std::string& path) {
 }
 
 
-void LoadMap(const char *fname, std::vector<bool> &map, int &width, int &height)
-{
-    FILE *f;
-    f = std::fopen(fname, "r");
-    if (f)
-    {
-        std::fscanf(f, "type octile\nheight %d\nwidth %d\nmap\n", &height, &width);
-        map.resize(height*width);
-        for (int y = 0; y < height; y++)
-        {
-            for (int x = 0; x < width; x++)
-            {
-                char c;
-                do {
-                    std::fscanf(f, "%c", &c);
-                } while (std::isspace(c));
-                map[y*width+x] = (c == '.' || c == 'G' || c == 'S');
-            }
-        }
-        std::fclose(f);
-    }
-}
-
 int main(int argc, char **argv)
 {
 
@@ -104,20 +387,51 @@ int main(int argc, char **argv)
         std::exit(1);
     }
 
-    // in mapData, 1: traversable, 0: obstacle
-    LoadMap(mapfile.c_str(), mapData, width, height);
+    if(!tracefile.empty()){
+        if(!trace::compiled){
+            std::cerr << "--trace needs a build configured with -DSTARTKIT_TRACE=ON" << std::endl;
+            std::exit(1);
+        }
+        trace::enabled = true;
+    }
 
-    if(grid2REC){
-       grid2rect::convertgrid2rect(mapData, width, height, outputfile+".rec");
+    if(verifyMesh){
+        if(!meshverify::verify_file(mapfile, validation, poly2mesh::num_threads)){
+            return 1;
+        }
+        std::printf("%s: OK\n", mapfile.c_str());
+        return 0;
     }
-    if(grid2CDT){
-        grid2poly::convertGrid2Poly(mapData, width, height, outputfile+".poly");
-        poly2mesh::convertPoly2Mesh(outputfile+".poly",outputfile+".cdt",width);
+
+    if(serveMode){
+        const Settings defaults = Settings::current();
+        return meshserver::serve(mapfile, [&](const meshserver::Request& request, std::vector<std::string>& written,
+                                              std::string& statsJson, std::string& error) {
+            return serveRequest(defaults, request, written, statsJson, error);
+        });
     }
-    if(grid2MCDT){
-        grid2poly::convertGrid2Poly(mapData, width, height, outputfile+".poly");
-        poly2mesh::convertPoly2Mesh(outputfile+".poly",outputfile+".cdt",width);
-        mesh2merged::convertMesh2MergedMesh(outputfile+".cdt",outputfile+".merged-cdt");
+
+    if(searchMesh){
+        meshsearch::run_benchmark(mapfile, scenariofile, searchKind);
+        return 0;
+    }
+
+    // in mapData, 1: traversable, 0: obstacle
+    {
+        stats::Scope scope("load");
+        LoadMap(mapfile.c_str(), mapData, width, height);
+    }
+    if(!convertMap()){
+        return 1;
+    }
+
+    if(!tracefile.empty() && !trace::write(tracefile)){
+        std::cerr << "Error writing " << tracefile << std::endl;
+        return 1;
+    }
+
+    if(printStats){
+        writeStats();
     }
 
 
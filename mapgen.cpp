@@ -0,0 +1,41 @@
+//
+// Writes a synthetic octile .map (see mapgen.h) for scaling and stress tests.
+//
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include "mapgen.h"
+#include "loadmap.h"
+
+void print_help(char **argv) {
+    std::printf("Invalid Arguments\nUsage %s <kind>:<width>x<height>[:<density>[:<seed>]] <output.map>\n", argv[0]);
+    std::printf("Kinds:\n");
+    std::printf("\tnoise : Each cell is an obstacle with probability density (default 0.3)\n");
+    std::printf("\tmaze : A perfect maze with corridors round(1 / density) - 1 cells wide\n");
+    std::printf("\trooms : Rooms joined by corridors, one per 32 x 32 block, taking up about 1 - density of it\n");
+    std::printf("\tstairs : Diagonal bands of obstacles with one-cell steps, density of every 32 cells wide\n");
+    std::printf("\topen : Open ground with scattered blocks of up to 64 x 64 cells covering density of it\n");
+    std::printf("\tcorridors : A serpentine of corridors 5 cells high, every third cell along the walls an obstacle with probability density\n");
+    std::printf("Width and height go up to %d.\n", mapgen::MAX_SIDE);
+}
+
+int main(int argc, char **argv)
+{
+    mapgen::Spec spec;
+    if (argc != 3 || !mapgen::parse_spec(argv[1], spec)) {
+        print_help(argv);
+        std::exit(1);
+    }
+
+    std::vector<bool> map;
+    mapgen::generate(spec, map);
+    if (!mapgen::write_map(argv[2], map, spec.width, spec.height)) {
+        std::fprintf(stderr, "Error writing %s\n", argv[2]);
+        return 1;
+    }
+    std::printf("%s: %d x %d, %lld traversable cells, %lld obstacle edges\n", argv[2], spec.width, spec.height,
+                (long long)std::count(map.begin(), map.end(), true), CountObstacleEdges(map, spec.width, spec.height));
+    return 0;
+}
@@ -0,0 +1,251 @@
+//
+// Synthetic octile maps for scaling and stress tests: random noise, mazes, rooms and corridors, diagonal
+// staircases, open fields and a serpentine of long corridors, up to 32768 x 32768 cells.
+//
+
+#ifndef STARTKIT_MAPGEN_H
+#define STARTKIT_MAPGEN_H
+#include <string>
+#include <vector>
+#include <random>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+namespace mapgen {
+    using std::string;
+    using std::vector;
+
+    enum Kind {NOISE, MAZE, ROOMS, STAIRS, OPEN, CORRIDORS};
+    const char* const kind_names[] = {"noise", "maze", "rooms", "stairs", "open", "corridors"};
+    const int num_kinds = 6;
+    const int MAX_SIDE = 32768;
+
+    struct Spec {
+        Kind kind = NOISE;
+        int width = 0, height = 0;
+        double density = 0.3; // about the fraction of cells that are obstacles
+        unsigned seed = 1;
+    };
+
+    // KIND:WxH[:DENSITY[:SEED]], e.g. "maze:4096x4096:0.4:7". "random" is another name for "noise".
+    bool parse_spec(const string& text, Spec& spec) {
+        const size_t colon = text.find(':');
+        if(colon == string::npos){
+            return false;
+        }
+        const string name = text.substr(0, colon);
+        int kind = name == "random" ? NOISE : -1;
+        for(int k = 0; k < num_kinds; k++){
+            if(name == kind_names[k]){
+                kind = k;
+            }
+        }
+        if(kind == -1){
+            return false;
+        }
+        spec = Spec();
+        spec.kind = (Kind)kind;
+        if(std::sscanf(text.c_str() + colon + 1, "%dx%d:%lf:%u",
+                       &spec.width, &spec.height, &spec.density, &spec.seed) < 2){
+            return false;
+        }
+        return spec.width >= 1 && spec.height >= 1 && spec.width <= MAX_SIDE && spec.height <= MAX_SIDE &&
+               spec.density >= 0 && spec.density <= 1;
+    }
+
+    // map[y * width + x] is true for traversable cells, as LoadMap gives them.
+    class Grid {
+    public:
+        Grid(vector<bool>& map, int width, int height) : map(map), width(width), height(height) {}
+
+        // Set a rectangle, clipped to the map; returns how many cells changed.
+        long long fill(int x0, int y0, int x1, int y1, bool traversable) {
+            x0 = std::max(x0, 0);
+            y0 = std::max(y0, 0);
+            x1 = std::min(x1, width);
+            y1 = std::min(y1, height);
+            long long changed = 0;
+            for(int y = y0; y < y1; y++){
+                for(int x = x0; x < x1; x++){
+                    auto cell = map[(size_t)y * width + x];
+                    changed += cell != traversable;
+                    cell = traversable;
+                }
+            }
+            return changed;
+        }
+
+        vector<bool>& map;
+        const int width, height;
+    };
+
+    void noise(const Spec& spec, Grid& grid, std::mt19937& rng) {
+        std::bernoulli_distribution obstacle(spec.density);
+        for(size_t i = 0; i < grid.map.size(); i++){
+            grid.map[i] = !obstacle(rng);
+        }
+    }
+
+    // A perfect maze made row by row with the sidewinder algorithm, so memory stays linear in the width.
+    // Corridors are round(1 / DENSITY) - 1 cells wide with one-cell walls; the rows and columns left over
+    // at the right and bottom are walls.
+    void maze(const Spec& spec, Grid& grid, std::mt19937& rng) {
+        if(spec.density == 0){
+            grid.fill(0, 0, grid.width, grid.height, true);
+            return;
+        }
+        const int corridor = std::max(1, (int)std::lround(1 / spec.density) - 1);
+        const int pitch = corridor + 1;
+        const int cols = (grid.width - 1) / pitch, rows = (grid.height - 1) / pitch;
+        grid.fill(0, 0, grid.width, grid.height, false);
+        std::bernoulli_distribution carve_east(0.5);
+        for(int r = 0; r < rows; r++){
+            const int y = 1 + r * pitch;
+            int run_start = 0;
+            for(int c = 0; c < cols; c++){
+                const int x = 1 + c * pitch;
+                grid.fill(x, y, x + corridor, y + corridor, true);
+                const bool last = c == cols - 1;
+                if(!last && (r == 0 || carve_east(rng))){
+                    grid.fill(x + corridor, y, x + pitch, y + corridor, true);
+                }else if(r > 0){
+                    // close the run with a passage north from one of its cells
+                    std::uniform_int_distribution<int> pick(run_start, c);
+                    const int north_x = 1 + pick(rng) * pitch;
+                    grid.fill(north_x, y - 1, north_x + corridor, y, true);
+                    run_start = c + 1;
+                }
+            }
+        }
+    }
+
+    // Rooms on a lattice of 32-cell blocks, one per block, joined by L-shaped corridors to the room to the
+    // right and, for some blocks and always in the first column, to the room below, so every room is
+    // reachable. DENSITY sets how much of its block a room takes up.
+    void rooms(const Spec& spec, Grid& grid, std::mt19937& rng) {
+        const int block = 32;
+        const int cols = (grid.width + block - 1) / block, rows = (grid.height + block - 1) / block;
+        const double side = block * std::sqrt(1 - spec.density);
+        std::uniform_int_distribution<int> room_side(std::max(2, (int)(side * 0.8)), std::max(2, (int)(side * 1.2)));
+        std::uniform_int_distribution<int> corridor_width(1, 2);
+        std::bernoulli_distribution link_down(0.5);
+        grid.fill(0, 0, grid.width, grid.height, false);
+
+        struct Room {
+            int x, y; // centre
+        };
+        vector<Room> above(cols), row(cols);
+        // where a room with this much slack goes in its block, keeping a wall on both sides when there is room
+        auto offset = [&](int slack) {
+            return slack >= 2 ? std::uniform_int_distribution<int>(1, slack - 1)(rng) : 0;
+        };
+        auto corridor = [&](Room a, Room b) {
+            const int w = corridor_width(rng);
+            grid.fill(std::min(a.x, b.x), a.y, std::max(a.x, b.x) + w, a.y + w, true);
+            grid.fill(b.x, std::min(a.y, b.y), b.x + w, std::max(a.y, b.y) + w, true);
+        };
+        for(int r = 0; r < rows; r++){
+            for(int c = 0; c < cols; c++){
+                const int bx = c * block, by = r * block;
+                const int bw = std::min(block, grid.width - bx), bh = std::min(block, grid.height - by);
+                const int w = std::min(room_side(rng), std::max(1, bw - 2));
+                const int h = std::min(room_side(rng), std::max(1, bh - 2));
+                const int x = bx + offset(bw - w), y = by + offset(bh - h);
+                grid.fill(x, y, x + w, y + h, true);
+                row[c] = {x + w / 2, y + h / 2};
+                if(c > 0){
+                    corridor(row[c - 1], row[c]);
+                }
+                if(r > 0 && (c == 0 || link_down(rng))){
+                    corridor(above[c], row[c]);
+                }
+            }
+            above.swap(row);
+        }
+    }
+
+    // Diagonal bands of obstacles whose sides are one-cell staircases: every cell along a band edge is a
+    // corner, the worst case for the number of mesh vertices per obstacle edge. The bands repeat every
+    // 32 cells and are DENSITY of that wide.
+    void stairs(const Spec& spec, Grid& grid, std::mt19937&) {
+        const int period = 32;
+        const int band = (int)std::lround(period * spec.density);
+        for(int y = 0; y < grid.height; y++){
+            for(int x = 0; x < grid.width; x++){
+                grid.map[(size_t)y * grid.width + x] = (int)(((long long)x + y + spec.seed) % period) >= band;
+            }
+        }
+    }
+
+    // Open ground with scattered rectangular blocks of up to 64 x 64 cells, added until DENSITY of the
+    // cells are blocked.
+    void open(const Spec& spec, Grid& grid, std::mt19937& rng) {
+        grid.fill(0, 0, grid.width, grid.height, true);
+        const long long target = (long long)std::llround(spec.density * grid.map.size());
+        std::uniform_int_distribution<int> size(1, 64), x(0, grid.width - 1), y(0, grid.height - 1);
+        long long blocked = 0;
+        // blocks can overlap, so cap the attempts for densities near 1
+        for(long long attempt = 0; blocked < target && attempt < (long long)grid.map.size(); attempt++){
+            const int bx = x(rng), by = y(rng);
+            blocked += grid.fill(bx, by, bx + size(rng), by + size(rng), false);
+        }
+    }
+
+    // One serpentine path of horizontal corridors 5 cells high between one-cell walls, each wall open at
+    // the right and left end in turn. Every third cell along the walls is an obstacle with probability
+    // DENSITY. The long rows of vertices this gives are the worst case for a sweep along y.
+    void corridors(const Spec& spec, Grid& grid, std::mt19937& rng) {
+        const int pitch = 6;
+        std::bernoulli_distribution obstacle(spec.density);
+        grid.fill(0, 0, grid.width, grid.height, false);
+        for(int y = 1, r = 0; y + pitch - 1 < grid.height; y += pitch, r++){
+            grid.fill(1, y, grid.width - 1, y + pitch - 1, true);
+            if(y + 2 * pitch - 1 < grid.height){
+                const int gap = r % 2 == 0 ? grid.width - 2 : 1;
+                grid.fill(gap, y + pitch - 1, gap + 1, y + pitch, true);
+            }
+            for(int x = 2; x < grid.width - 2; x += 3){
+                if(obstacle(rng)){
+                    grid.fill(x, y, x + 1, y + 1, false);
+                }
+                if(obstacle(rng)){
+                    grid.fill(x, y + pitch - 2, x + 1, y + pitch - 1, false);
+                }
+            }
+        }
+    }
+
+    void generate(const Spec& spec, vector<bool>& map) {
+        map.assign((size_t)spec.width * spec.height, true);
+        Grid grid(map, spec.width, spec.height);
+        std::mt19937 rng(spec.seed);
+        switch(spec.kind){
+            case NOISE: noise(spec, grid, rng); break;
+            case MAZE: maze(spec, grid, rng); break;
+            case ROOMS: rooms(spec, grid, rng); break;
+            case STAIRS: stairs(spec, grid, rng); break;
+            case OPEN: open(spec, grid, rng); break;
+            case CORRIDORS: corridors(spec, grid, rng); break;
+        }
+    }
+
+    // Write an octile .map, '.' for traversable and '@' for obstacles.
+    bool write_map(const string& filename, const vector<bool>& map, int width, int height) {
+        FILE* f = std::fopen(filename.c_str(), "w");
+        if(f == nullptr){
+            return false;
+        }
+        std::fprintf(f, "type octile\nheight %d\nwidth %d\nmap\n", height, width);
+        string line(width + 1, '\n');
+        for(int y = 0; y < height; y++){
+            for(int x = 0; x < width; x++){
+                line[x] = map[(size_t)y * width + x] ? '.' : '@';
+            }
+            std::fwrite(line.data(), 1, line.size(), f);
+        }
+        return std::fclose(f) == 0;
+    }
+}
+
+#endif //STARTKIT_MAPGEN_H
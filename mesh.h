@@ -0,0 +1,241 @@
+//
+// Flat in-memory copy of a mesh file (.rec, .cdt or .merged-cdt).
+//
+
+#ifndef STARTKIT_MESH_H
+#define STARTKIT_MESH_H
+#include <vector>
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <cstdlib>
+#include <cerrno>
+#include <cctype>
+#include <utility>
+
+namespace mesh {
+    using std::vector;
+    using std::string;
+
+    struct Point {
+        double x, y;
+    };
+
+    // Every list is stored back to back in one array, with an offset array in front:
+    // the polygons around vertex v are vertex_polygons[vertex_start[v] .. vertex_start[v + 1]),
+    // the vertices of polygon p are polygon_vertices[polygon_start[p] .. polygon_start[p + 1]),
+    // and polygon_neighbours at the same positions holds the polygon across the edge ending at that vertex.
+    struct Mesh {
+        vector<Point> points;
+        vector<int> vertex_start;
+        vector<int> vertex_polygons;
+        vector<int> polygon_start;
+        vector<int> polygon_vertices;
+        vector<int> polygon_neighbours;
+
+        int num_vertices() const {
+            return (int)points.size();
+        }
+        int num_polygons() const {
+            return (int)polygon_start.size() - 1;
+        }
+    };
+
+    void fail(const string& message) {
+        std::cerr << message << std::endl;
+        exit(1);
+    }
+
+    // Reads whitespace separated numbers out of a whole file at once, which is much faster than istream >>.
+    class Tokens {
+    public:
+        explicit Tokens(string text) : text(std::move(text)), pos(this->text.c_str()) {}
+
+        bool next_int(int& value) {
+            char* end;
+            errno = 0;
+            long parsed = strtol(pos, &end, 10);
+            if(end == pos || errno != 0 || parsed != (int)parsed){
+                return false;
+            }
+            value = (int)parsed;
+            pos = end;
+            return true;
+        }
+
+        bool next_double(double& value) {
+            char* end;
+            value = strtod(pos, &end);
+            if(end == pos){
+                return false;
+            }
+            pos = end;
+            return true;
+        }
+
+        bool next_word(string& word) {
+            skip_space();
+            const char* start = pos;
+            while(*pos != '\0' && !isspace((unsigned char)*pos)){
+                pos++;
+            }
+            word.assign(start, pos);
+            return pos != start;
+        }
+
+        bool at_end() {
+            skip_space();
+            return *pos == '\0';
+        }
+
+    private:
+        void skip_space() {
+            while(isspace((unsigned char)*pos)){
+                pos++;
+            }
+        }
+
+        string text;
+        const char* pos;
+    };
+
+    // Read a mesh in the format described in README.md, checking only what is needed to store it safely:
+    // the header, the counts, and that every index is in range.
+    void read_mesh(std::istream& infile, Mesh& mesh) {
+        std::stringstream buffer;
+        buffer << infile.rdbuf();
+        Tokens tokens(buffer.str());
+
+        string header;
+        int version;
+        if(!tokens.next_word(header)){
+            fail("Error reading header");
+        }
+        if(header != "mesh"){
+            fail("Invalid header (expecting 'mesh')");
+        }
+        if(!tokens.next_int(version)){
+            fail("Error getting version number");
+        }
+        if(version != 2){
+            fail("Invalid version (expecting 2)");
+        }
+
+        int V, P;
+        if(!tokens.next_int(V) || !tokens.next_int(P)){
+            fail("Error getting V and P");
+        }
+        if(V < 1){
+            fail("Invalid number of vertices");
+        }
+        if(P < 1){
+            fail("Invalid number of polygons");
+        }
+
+        mesh.points.resize(V);
+        mesh.vertex_start.assign(1, 0);
+        mesh.vertex_start.reserve(V + 1);
+        mesh.vertex_polygons.clear();
+        for(int i = 0; i < V; i++){
+            Point& p = mesh.points[i];
+            if(!tokens.next_double(p.x) || !tokens.next_double(p.y)){
+                fail("Error getting vertex point");
+            }
+            int neighbours;
+            if(!tokens.next_int(neighbours)){
+                fail("Error getting vertex neighbours");
+            }
+            if(neighbours < 2){
+                fail("Invalid number of neighbours around a point");
+            }
+            for(int j = 0; j < neighbours; j++){
+                int polygon_index;
+                if(!tokens.next_int(polygon_index)){
+                    fail("Error getting a vertex's neighbouring polygon");
+                }
+                if(polygon_index < -1 || polygon_index >= P){
+                    fail("Invalid polygon index when getting vertex");
+                }
+                mesh.vertex_polygons.push_back(polygon_index);
+            }
+            mesh.vertex_start.push_back((int)mesh.vertex_polygons.size());
+        }
+
+        mesh.polygon_start.assign(1, 0);
+        mesh.polygon_start.reserve(P + 1);
+        mesh.polygon_vertices.clear();
+        mesh.polygon_neighbours.clear();
+        for(int i = 0; i < P; i++){
+            int n;
+            if(!tokens.next_int(n)){
+                fail("Error getting number of vertices of polygon");
+            }
+            if(n < 3){
+                fail("Invalid number of vertices in polygon");
+            }
+            for(int j = 0; j < n; j++){
+                int vertex_index;
+                if(!tokens.next_int(vertex_index)){
+                    fail("Error getting a polygon's vertex");
+                }
+                if(vertex_index < 0 || vertex_index >= V){
+                    fail("Invalid vertex index when getting polygon");
+                }
+                mesh.polygon_vertices.push_back(vertex_index);
+            }
+            for(int j = 0; j < n; j++){
+                int polygon_index;
+                if(!tokens.next_int(polygon_index)){
+                    fail("Error getting a polygon's neighbouring polygon");
+                }
+                if(polygon_index < -1 || polygon_index >= P){
+                    fail("Invalid polygon index when getting polygon");
+                }
+                mesh.polygon_neighbours.push_back(polygon_index);
+            }
+            mesh.polygon_start.push_back((int)mesh.polygon_vertices.size());
+        }
+
+        if(!tokens.at_end()){
+            fail("Error parsing mesh (read too much)");
+        }
+    }
+
+    // Write a mesh the way mesh2merged::print_mesh does.
+    void write_mesh(std::ostream& outfile, const Mesh& mesh) {
+        outfile << "mesh\n";
+        outfile << "2\n";
+        outfile << mesh.num_vertices() << " " << mesh.num_polygons() << "\n";
+        for(int i = 0; i < mesh.num_vertices(); i++){
+            outfile << mesh.points[i].x << " " << mesh.points[i].y << " ";
+            outfile << mesh.vertex_start[i + 1] - mesh.vertex_start[i] << " ";
+            for(int k = mesh.vertex_start[i]; k < mesh.vertex_start[i + 1]; k++){
+                outfile << (k == mesh.vertex_start[i] ? "" : " ") << mesh.vertex_polygons[k];
+            }
+            outfile << "\n";
+        }
+        for(int i = 0; i < mesh.num_polygons(); i++){
+            const int begin = mesh.polygon_start[i], end = mesh.polygon_start[i + 1];
+            outfile << end - begin << " ";
+            for(int k = begin; k < end; k++){
+                outfile << (k == begin ? "" : " ") << mesh.polygon_vertices[k];
+            }
+            outfile << " ";
+            for(int k = begin; k < end; k++){
+                outfile << (k == begin ? "" : " ") << mesh.polygon_neighbours[k];
+            }
+            outfile << "\n";
+        }
+    }
+
+    void read_mesh(const string& filename, Mesh& mesh) {
+        std::ifstream infile(filename);
+        if(!infile){
+            fail("Error opening " + filename);
+        }
+        read_mesh(infile, mesh);
+    }
+}
+
+#endif //STARTKIT_MESH_H
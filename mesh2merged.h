@@ -14,7 +14,20 @@
 #include <climits>
 #include <cmath>
 #include <queue>
+#include <functional>
+#include <algorithm>
 #include <fstream>
+#include <sstream>
+#include <chrono>
+#include <iomanip>
+#include <thread>
+#include <atomic>
+#include "counters.h"
+#include "predicates.h"
+#include "mesh.h"
+#include "meshrefine.h"
+#include "stats.h"
+#include "trace.h"
 using namespace std;
 namespace mesh2merged {
     bool pretty = false;
@@ -32,11 +45,23 @@ namespace mesh2merged {
                 return -1;
             }
             if (parent[x] != x) {
-                parent[x] = find(parent[x]);
+                const int root = find(parent[x]);
+                // only write when compressing, so finds on a flattened
+                // structure can run on several threads
+                if (parent[x] != root) {
+                    parent[x] = root;
+                }
             }
             return parent[x];
         }
 
+        // Point everything straight at its root.
+        void flatten() {
+            for (int i = 0; i < (int) parent.size(); i++) {
+                find(i);
+            }
+        }
+
         // can't use "union" as that's a keyword!
         // also: don't use union by rank as we need find(x) == x after merge.
         void merge(int x, int y) {
@@ -77,6 +102,7 @@ namespace mesh2merged {
         for (auto x: list_nodes) {
             delete x;
         }
+        list_nodes.clear();
     }
 
     struct Point {
@@ -114,17 +140,41 @@ namespace mesh2merged {
     struct SearchNode {
         // Index of poly.
         int index;
-        // Area of the best tentative merge.
-        double area;
+        // Priority of the best tentative merge.
+        double priority;
 
         // Comparison.
         // Always take the "biggest" search node in a priority queue.
         bool operator<(const SearchNode &other) const {
-            return area < other.area;
+            return priority < other.priority;
         }
 
         bool operator>(const SearchNode &other) const {
-            return area > other.area;
+            return priority > other.priority;
+        }
+    };
+
+// Merge priorities. smart_merge and matching_merge take one as a template
+// argument, call Priority::of(a, b) for every candidate merge of a with b, and
+// merge the highest priorities first. Merges with priority <= 0 are not made.
+
+// The merged area: big polygons first.
+    struct AreaPriority {
+        static double of(const Polygon &a, const Polygon &b) {
+            return a.area + b.area;
+        }
+    };
+
+// Area per unit of expansion cost of the merged polygon. Expanding a polygon
+// generates a successor for every traversable edge and scans every vertex, so
+// this grows polygons that cover a lot of ground with few ways out and few
+// corners, before the ones that branch or zigzag. The merged polygon loses
+// the two ends of the shared edge and the shared edge itself on both sides.
+    struct SearchCostPriority {
+        static double of(const Polygon &a, const Polygon &b) {
+            const int traversable = a.num_traversable + b.num_traversable - 2;
+            const int vertices = a.num_vertices + b.num_vertices - 2;
+            return (a.area + b.area) / (traversable + vertices);
         }
     };
 
@@ -138,6 +188,55 @@ namespace mesh2merged {
 
     UnionFind polygon_unions(0);
 
+    enum MergeStrategy {SMART, MATCHING};
+    MergeStrategy merge_strategy = SMART;
+
+// Which of the priorities above to merge by.
+    enum MergePriority {AREA, SEARCH_COST};
+    MergePriority merge_priority = AREA;
+
+// Threads used by matching_merge (0: one per hardware thread).
+    int num_threads = 0;
+
+// Re-partition small regions after merging when that gives fewer polygons
+// (see meshrefine.h).
+    bool refine = false;
+
+// Merging stops once it has run for merge_time_limit seconds or made
+// merge_limit merges (0: no limit). Every merge leaves a valid mesh, so the
+// mesh printed after stopping early is valid, only less merged.
+    double merge_time_limit = 0;
+    long long merge_limit = 0;
+
+    std::chrono::steady_clock::time_point merge_deadline;
+    long long merges_done = 0;
+    bool merge_stopped = false;
+// Polygons that could still merge with a neighbour when smart_merge or
+// matching_merge stopped.
+    long long mergeable_left = 0;
+
+    void start_merge_budget() {
+        merge_deadline = std::chrono::steady_clock::now() +
+                         std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                                 std::chrono::duration<double>(merge_time_limit));
+        merges_done = 0;
+        merge_stopped = false;
+        mergeable_left = 0;
+    }
+
+    bool out_of_merge_budget() {
+        if (!merge_stopped &&
+            ((merge_limit > 0 && merges_done >= merge_limit) ||
+             (merge_time_limit > 0 && std::chrono::steady_clock::now() >= merge_deadline))) {
+            merge_stopped = true;
+        }
+        return merge_stopped;
+    }
+
+// Are all vertex coordinates integers small enough that cross products of
+// their differences are exact in 64 bits? Set by read_mesh.
+    bool lattice_coordinates = false;
+
 // Actually returns double the area of the polygon...
 // Assume that mesh_vertices is populated and is valid.
     double get_area(ListNodePtr vertices) {
@@ -160,6 +259,7 @@ namespace mesh2merged {
 
 // taken from structs/mesh.cpp
     void read_mesh(istream &infile) {
+        TRACE_SCOPE("read_mesh");
 #define fail(message) cerr << message << endl; exit(1);
         string header;
         int version;
@@ -196,6 +296,7 @@ namespace mesh2merged {
         mesh_vertices.resize(V);
         mesh_polygons.resize(P);
         polygon_unions = UnionFind(P);
+        lattice_coordinates = true;
 
 
         for (int i = 0; i < V; i++) {
@@ -203,6 +304,11 @@ namespace mesh2merged {
             if (!(infile >> v.p.x >> v.p.y)) {
                 fail("Error getting vertex point");
             }
+            for (double c : {v.p.x, v.p.y}) {
+                if (c != std::floor(c) || std::fabs(c) >= (1 << 30)) {
+                    lattice_coordinates = false;
+                }
+            }
             int neighbours;
             if (!(infile >> neighbours)) {
                 fail("Error getting vertex neighbours");
@@ -316,8 +422,17 @@ namespace mesh2merged {
 #undef fail
     }
 
+// Does a -> b -> c turn clockwise? Collinear points don't.
+// Exact: in integers for lattice meshes, with robust predicates otherwise.
     inline bool cw(const Point &a, const Point &b, const Point &c) {
-        return (b - a) * (c - b) < -1e-8;
+        if (lattice_coordinates) {
+            const long long abx = (long long) b.x - (long long) a.x;
+            const long long aby = (long long) b.y - (long long) a.y;
+            const long long bcx = (long long) c.x - (long long) b.x;
+            const long long bcy = (long long) c.y - (long long) b.y;
+            return abx * bcy - aby * bcx < 0;
+        }
+        return predicates::adaptive::orient2d(a.x, a.y, b.x, b.y, c.x, c.y) < 0;
     }
 
 // Can polygon x merge with the polygon adjacent to the edge
@@ -329,6 +444,7 @@ namespace mesh2merged {
 // This also means that the actual polygon used will be p->next->next.
 // Also assume that x is a valid non-merged polygon.
     bool can_merge(int x, ListNodePtr v, ListNodePtr p) {
+        COUNT(merge_can_merge, 1);
         if (polygon_unions.find(x) != x) {
             return false;
         }
@@ -359,6 +475,7 @@ namespace mesh2merged {
             counter++;
             assert(counter <= to_merge.num_vertices);
         }
+        COUNT(merge_ring_steps, counter + 1);
         // Ensure that A comes after B.
         assert(merge_end_v->go(2)->val == A);
         // Ensure that the neighbouring polygon is x.
@@ -471,6 +588,7 @@ namespace mesh2merged {
         // Do the union-find merge.
         // THIS NEEDS TO BE LAST.
         polygon_unions.merge(x, merge_index);
+        merges_done++;
     }
 
     void check_correct() {
@@ -536,108 +654,162 @@ namespace mesh2merged {
         }
     }
 
-    void merge_deadend() {
-        bool merged = false;
-        do {
-            merged = false;
-            for (int i = 0; i < (int) mesh_polygons.size(); i++) {
-                Polygon &p = mesh_polygons[i];
-                if (polygon_unions.find(i) != i || p.num_vertices == 0) {
-                    // Has been merged.
-                    continue;
+// Runs try_merge(i) on polygons in the same order as repeatedly looping over
+// all polygons until nothing merges, so the merges (and the output) are the
+// same. But a polygon is only looked at again once it or one of its
+// neighbours has changed, as nothing else can make a failed merge succeed.
+// try_merge(i) returns whether polygon i merged with a neighbour.
+// After a merge at polygon i, a changed polygon j is looked at later in this
+// round if j > i, otherwise in the next one.
+    template<typename TryMerge>
+    void merge_worklist(TryMerge try_merge) {
+        // Polygons of this round in increasing order, and the ones added to
+        // it after it started.
+        vector<int> this_round(mesh_polygons.size());
+        iota(this_round.begin(), this_round.end(), 0);
+        priority_queue<int, vector<int>, greater<int>> added;
+        vector<int> next_round;
+        vector<bool> queued(mesh_polygons.size(), true);
+
+        while (!this_round.empty()) {
+            size_t next = 0;
+            while (next < this_round.size() || !added.empty()) {
+                if (out_of_merge_budget()) {
+                    return;
+                }
+                int i;
+                if (added.empty() ||
+                    (next < this_round.size() && this_round[next] < added.top())) {
+                    i = this_round[next++];
+                } else {
+                    i = added.top();
+                    added.pop();
                 }
-                // We want dead ends here.
-                if (p.num_traversable != 1) {
+                queued[i] = false;
+                if (!try_merge(i)) {
                     continue;
                 }
 
-                // Remember that the polygon we merge with is polygons->go(2).
-
-                {
-                    const int merge_index = polygon_unions.find(
-                            p.polygons->go(2)->val);
-                    if (merge_index != -1 &&
-                        mesh_polygons[merge_index].num_traversable <= 2 &&
-                        can_merge(i, p.vertices, p.polygons)) {
-                        merge(i, p.vertices, p.polygons);
-                        merged = true;
-                        continue;
+                auto enqueue = [&](int j) {
+                    if (j == -1 || queued[j]) {
+                        return;
                     }
-                }
-
-                ListNodePtr cur_node_v = p.vertices->next;
-                ListNodePtr cur_node_p = p.polygons->next;
-                while (cur_node_v != p.vertices) {
-                    const int merge_index = polygon_unions.find(
-                            cur_node_p->go(2)->val);
-                    if (merge_index != -1 &&
-                        mesh_polygons[merge_index].num_traversable <= 2 &&
-                        can_merge(i, cur_node_v, cur_node_p)) {
-                        merge(i, cur_node_v, cur_node_p);
-                        merged = true;
-                        break;
+                    queued[j] = true;
+                    if (j > i) {
+                        added.push(j);
+                    } else {
+                        next_round.push_back(j);
                     }
-
-                    cur_node_v = cur_node_v->next;
+                };
+                enqueue(i);
+                const Polygon &p = mesh_polygons[i];
+                ListNodePtr cur_node_p = p.polygons;
+                bool first = true;
+                while (first || cur_node_p != p.polygons) {
+                    first = false;
+                    enqueue(polygon_unions.find(cur_node_p->val));
                     cur_node_p = cur_node_p->next;
                 }
             }
-        } while (merged);
+            sort(next_round.begin(), next_round.end());
+            this_round.swap(next_round);
+            next_round.clear();
+        }
     }
 
-    void naive_merge(bool keep_deadends = true) {
-        bool merged = false;
-        do {
-            merged = false;
-            for (int i = 0; i < (int) mesh_polygons.size(); i++) {
-                Polygon &p = mesh_polygons[i];
-                if (polygon_unions.find(i) != i || p.num_vertices == 0) {
-                    // Has been merged.
-                    continue;
-                }
+    void merge_deadend() {
+        TRACE_SCOPE("merge_deadend");
+        merge_worklist([](int i) {
+            Polygon &p = mesh_polygons[i];
+            if (polygon_unions.find(i) != i || p.num_vertices == 0) {
+                // Has been merged.
+                return false;
+            }
+            // We want dead ends here.
+            if (p.num_traversable != 1) {
+                return false;
+            }
 
-                if (keep_deadends && p.num_traversable == 1) {
-                    // It's a dead end and we want to keep it.
-                    continue;
+            // Remember that the polygon we merge with is polygons->go(2).
+
+            {
+                const int merge_index = polygon_unions.find(
+                        p.polygons->go(2)->val);
+                if (merge_index != -1 &&
+                    mesh_polygons[merge_index].num_traversable <= 2 &&
+                    can_merge(i, p.vertices, p.polygons)) {
+                    merge(i, p.vertices, p.polygons);
+                    return true;
                 }
+            }
 
-                {
-                    const int merge_index = polygon_unions.find(
-                            p.polygons->go(2)->val);
-                    if (merge_index != -1 &&
-                        (!keep_deadends ||
-                         mesh_polygons[merge_index].num_traversable > 1) &&
-                        can_merge(i, p.vertices, p.polygons)) {
-                        merge(i, p.vertices, p.polygons);
-                        merged = true;
-                        // prevents an infinite loop?
-                        continue;
-                    }
+            ListNodePtr cur_node_v = p.vertices->next;
+            ListNodePtr cur_node_p = p.polygons->next;
+            while (cur_node_v != p.vertices) {
+                const int merge_index = polygon_unions.find(
+                        cur_node_p->go(2)->val);
+                if (merge_index != -1 &&
+                    mesh_polygons[merge_index].num_traversable <= 2 &&
+                    can_merge(i, cur_node_v, cur_node_p)) {
+                    merge(i, cur_node_v, cur_node_p);
+                    return true;
                 }
 
-                ListNodePtr cur_node_v = p.vertices->next;
-                ListNodePtr cur_node_p = p.polygons->next;
-                while (cur_node_v != p.vertices) {
-                    const int merge_index = polygon_unions.find(
-                            cur_node_p->go(2)->val);
-                    if (merge_index != -1 &&
-                        (!keep_deadends ||
-                         mesh_polygons[merge_index].num_traversable > 1) &&
-                        can_merge(i, cur_node_v, cur_node_p)) {
-                        merge(i, cur_node_v, cur_node_p);
-                        merged = true;
-                        // break just in case
-                        break;
-                    }
+                cur_node_v = cur_node_v->next;
+                cur_node_p = cur_node_p->next;
+            }
+            return false;
+        });
+    }
 
-                    cur_node_v = cur_node_v->next;
-                    cur_node_p = cur_node_p->next;
+    void naive_merge(bool keep_deadends = true) {
+        merge_worklist([keep_deadends](int i) {
+            Polygon &p = mesh_polygons[i];
+            if (polygon_unions.find(i) != i || p.num_vertices == 0) {
+                // Has been merged.
+                return false;
+            }
+
+            if (keep_deadends && p.num_traversable == 1) {
+                // It's a dead end and we want to keep it.
+                return false;
+            }
+
+            {
+                const int merge_index = polygon_unions.find(
+                        p.polygons->go(2)->val);
+                if (merge_index != -1 &&
+                    (!keep_deadends ||
+                     mesh_polygons[merge_index].num_traversable > 1) &&
+                    can_merge(i, p.vertices, p.polygons)) {
+                    merge(i, p.vertices, p.polygons);
+                    return true;
                 }
             }
-        } while (merged);
+
+            ListNodePtr cur_node_v = p.vertices->next;
+            ListNodePtr cur_node_p = p.polygons->next;
+            while (cur_node_v != p.vertices) {
+                const int merge_index = polygon_unions.find(
+                        cur_node_p->go(2)->val);
+                if (merge_index != -1 &&
+                    (!keep_deadends ||
+                     mesh_polygons[merge_index].num_traversable > 1) &&
+                    can_merge(i, cur_node_v, cur_node_p)) {
+                    merge(i, cur_node_v, cur_node_p);
+                    return true;
+                }
+
+                cur_node_v = cur_node_v->next;
+                cur_node_p = cur_node_p->next;
+            }
+            return false;
+        });
     }
 
+    template<typename Priority = AreaPriority>
     void smart_merge(bool keep_deadends = true) {
+        TRACE_SCOPE("smart_merge");
         priority_queue<SearchNode> pq;
         // As we aren't going to do pq updates, here's a shoddy workaround.
         vector<double> best_merge(mesh_polygons.size(), -1);
@@ -671,8 +843,8 @@ namespace mesh2merged {
                     (!keep_deadends ||
                      mesh_polygons[merge_index].num_traversable > 1) &&
                     can_merge(i, cur_node_v, cur_node_p)) {
-                    this_node.area = max(this_node.area,
-                                         p.area + mesh_polygons[merge_index].area);
+                    this_node.priority = max(this_node.priority,
+                                             Priority::of(p, mesh_polygons[merge_index]));
                 }
 
                 cur_node_v = cur_node_v->next;
@@ -680,9 +852,9 @@ namespace mesh2merged {
             }
 
             // Chuck it on the pq... if we found a valid merge.
-            if (this_node.area != -1) {
+            if (this_node.priority > 0) {
                 pq.push(this_node);
-                best_merge[i] = this_node.area;
+                best_merge[i] = this_node.priority;
             } else {
                 // We need to invalidate this if there isn't a valid merge.
                 best_merge[i] = -1;
@@ -695,10 +867,19 @@ namespace mesh2merged {
 
 
         while (!pq.empty()) {
+            if (out_of_merge_budget()) {
+                for (int i = 0; i < (int) mesh_polygons.size(); i++) {
+                    if (best_merge[i] != -1 && polygon_unions.find(i) == i) {
+                        mergeable_left++;
+                    }
+                }
+                return;
+            }
             SearchNode node = pq.top();
             pq.pop();
-            if (abs(node.area - best_merge[node.index]) > 1e-8) {
+            if (abs(node.priority - best_merge[node.index]) > 1e-8) {
                 // Not the right node.
+                COUNT(merge_stale_pops, 1);
                 continue;
             }
             // We got an actual node!
@@ -718,8 +899,8 @@ namespace mesh2merged {
                     if (merge_index != -1 &&
                         (!keep_deadends ||
                          mesh_polygons[merge_index].num_traversable > 1) &&
-                        abs((p.area + mesh_polygons[merge_index].area)
-                            - node.area) < 1e-8 &&
+                        abs(Priority::of(p, mesh_polygons[merge_index])
+                            - node.priority) < 1e-8 &&
                         can_merge(node.index, cur_node_v, cur_node_p)) {
                         // Wait - before that, we need to invalidate the thing
                         // we merge with.
@@ -732,7 +913,14 @@ namespace mesh2merged {
                     cur_node_v = cur_node_v->next;
                     cur_node_p = cur_node_p->next;
                 }
-                assert(found);
+                if (!found) {
+                    // A stale node that happened to match best_merge within
+                    // the tolerance, which priorities with many near ties
+                    // can do. Look at this polygon again.
+                    COUNT(merge_stale_pops, 1);
+                    push_polygon(node.index);
+                    continue;
+                }
             }
 
             // Update THIS merge.
@@ -749,7 +937,201 @@ namespace mesh2merged {
         }
     }
 
+// Run f(i) for every i in [0, n) on num_threads threads.
+    template<typename F>
+    void parallel_for(int n, F f) {
+        const int chunk = 1024;
+        int workers = num_threads > 0 ? num_threads : (int) std::thread::hardware_concurrency();
+        workers = max(1, min(workers, n / chunk + 1));
+        std::atomic<int> next(0);
+        auto worker = [&]() {
+            TRACE_SCOPE("parallel_for worker");
+            for (int first = next.fetch_add(chunk); first < n; first = next.fetch_add(chunk)) {
+                const int last = min(n, first + chunk);
+                for (int i = first; i < last; i++) {
+                    f(i);
+                }
+            }
+        };
+        vector<std::thread> threads;
+        for (int i = 1; i < workers; i++) {
+            threads.emplace_back(worker);
+        }
+        worker();
+        for (auto &t : threads) {
+            t.join();
+        }
+    }
+
+// A merge polygon i could make: with neighbour `index` across the edge after
+// v, as in can_merge.
+    struct MergeCandidate {
+        int index;
+        double priority;
+        ListNodePtr v, p;
+    };
+
+// Is merging a with b (with priority a_priority) better than merging c with d?
+// Ties in priority are broken by index so that the heaviest pair is unique.
+    inline bool heavier(double a_priority, int a, int b, double c_priority, int c, int d) {
+        if (a_priority != c_priority) {
+            return a_priority > c_priority;
+        }
+        return make_pair(min(a, b), max(a, b)) < make_pair(min(c, d), max(c, d));
+    }
+
+// Merges in rounds, like multilevel graph coarsening, instead of one pair at
+// a time from a global heap.
+// Each round finds a maximal matching of mergeable neighbouring polygons,
+// preferring pairs with a higher priority: every unmatched polygon points at
+// its heaviest unmatched candidate, pairs pointing at each other are matched,
+// and that repeats until no pair is left. Candidates are found with
+// can_merge on all threads, and only for polygons that changed or have a
+// neighbour that changed. The matched pairs are disjoint, so none stops
+// another from staying convex, and all of them are merged before the next
+// round.
+// Same merge rule as smart_merge: the result differs but is as valid.
+    template<typename Priority = AreaPriority>
+    void matching_merge(bool keep_deadends = true) {
+        TRACE_SCOPE("matching_merge");
+        const int P = mesh_polygons.size();
+        vector<vector<MergeCandidate>> candidates(P);
+        vector<char> dirty(P, 1);
+        vector<char> matched(P, 0);
+        vector<int> best(P, -1);
+        vector<int> active;
+
+        auto find_candidates = [&](int i) {
+            vector<MergeCandidate> &out = candidates[i];
+            out.clear();
+            Polygon &p = mesh_polygons[i];
+            if (polygon_unions.find(i) != i || p.num_vertices == 0 ||
+                (keep_deadends && p.num_traversable == 1)) {
+                return;
+            }
+            ListNodePtr cur_node_v = p.vertices;
+            ListNodePtr cur_node_p = p.polygons;
+            bool first = true;
+            while (first || cur_node_v != p.vertices) {
+                first = false;
+                const int merge_index = polygon_unions.find(cur_node_p->go(2)->val);
+                if (merge_index != -1 &&
+                    (!keep_deadends ||
+                     mesh_polygons[merge_index].num_traversable > 1) &&
+                    can_merge(i, cur_node_v, cur_node_p)) {
+                    const double priority = Priority::of(p, mesh_polygons[merge_index]);
+                    if (priority > 0) {
+                        out.push_back({merge_index, priority, cur_node_v, cur_node_p});
+                    }
+                }
+                cur_node_v = cur_node_v->next;
+                cur_node_p = cur_node_p->next;
+            }
+        };
+
+        vector<int> changed;
+        for (int i = 0; i < P; i++) {
+            changed.push_back(i);
+        }
+        while (true) {
+            // Only finds without path compression below.
+            polygon_unions.flatten();
+            fill(best.begin(), best.end(), -1);
+            parallel_for(changed.size(), [&](int k) {
+                find_candidates(changed[k]);
+            });
+            for (int i : changed) {
+                dirty[i] = 0;
+            }
+
+            active.clear();
+            for (int i = 0; i < P; i++) {
+                if (!candidates[i].empty()) {
+                    active.push_back(i);
+                }
+            }
+            if (active.empty() || out_of_merge_budget()) {
+                mergeable_left = active.size();
+                return;
+            }
+
+            // Maximal matching.
+            while (true) {
+                parallel_for(active.size(), [&](int k) {
+                    const int i = active[k];
+                    best[i] = -1;
+                    double best_priority = 0;
+                    for (const MergeCandidate &c : candidates[i]) {
+                        if (!matched[c.index] &&
+                            (best[i] == -1 || heavier(c.priority, i, c.index, best_priority, i, best[i]))) {
+                            best[i] = c.index;
+                            best_priority = c.priority;
+                        }
+                    }
+                });
+                bool found = false;
+                vector<int> still_active;
+                for (int i : active) {
+                    const int j = best[i];
+                    if (j == -1) {
+                        continue;
+                    }
+                    if (best[j] == i) {
+                        matched[i] = 1;
+                        found = true;
+                    } else {
+                        still_active.push_back(i);
+                    }
+                }
+                active.swap(still_active);
+                if (!found) {
+                    break;
+                }
+            }
+
+            // Merge every matched pair into its lower index polygon.
+            changed.clear();
+            for (int i = 0; i < P; i++) {
+                if (!matched[i]) {
+                    continue;
+                }
+                matched[i] = 0;
+                if (polygon_unions.find(i) != i || best[i] < i || out_of_merge_budget()) {
+                    continue;
+                }
+                for (const MergeCandidate &c : candidates[i]) {
+                    if (c.index == best[i]) {
+                        merge(i, c.v, c.p);
+                        break;
+                    }
+                }
+                candidates[best[i]].clear();
+                dirty[i] = 1;
+            }
+            // The merged polygons and their neighbours get new candidates.
+            for (int i = 0; i < P; i++) {
+                if (dirty[i] != 1 || polygon_unions.find(i) != i) {
+                    continue;
+                }
+                changed.push_back(i);
+                const Polygon &p = mesh_polygons[i];
+                ListNodePtr cur_node_p = p.polygons;
+                bool first = true;
+                while (first || cur_node_p != p.polygons) {
+                    first = false;
+                    const int j = polygon_unions.find(cur_node_p->val);
+                    if (j != -1 && !dirty[j]) {
+                        dirty[j] = 2;
+                        changed.push_back(j);
+                    }
+                    cur_node_p = cur_node_p->next;
+                }
+            }
+        }
+    }
+
     void print_mesh(ostream &outfile) {
+        TRACE_SCOPE("print_mesh");
         outfile << "mesh\n";
         outfile << "2\n";
 
@@ -862,27 +1244,96 @@ namespace mesh2merged {
             outfile << "\n";
         }
 
-        // cerr << final_p << ";" << num_deadends << ";" << sum_traversable << endl;
+        stats::count("merge.vertices", final_v);
+        stats::count("merge.polygons", final_p);
+        stats::count("merge.dead_ends", num_deadends);
+        stats::count("merge.sum_traversable", sum_traversable);
 
 #undef get_p
 #undef get_v
     }
 
 
+// How far merging got: the polygon reduction reached, and whether it
+// stopped early.
+    void report_merge_budget(ostream &out) {
+        const long long before = mesh_polygons.size();
+        const long long after = before - merges_done;
+        out << "Merged " << before << " polygons into " << after << " ("
+            << merges_done << " merges, " << std::fixed << std::setprecision(1)
+            << 100.0 * merges_done / before << "% fewer polygons)";
+        if (merge_stopped) {
+            out << ", stopped early with " << mergeable_left
+                << " polygons still able to merge";
+        } else {
+            out << ", finished within the budget";
+        }
+        out << endl;
+        out.unsetf(std::ios::floatfield);
+    }
+
+// Merge with the chosen --merge strategy and --merge-priority, keeping dead ends.
+    void merge_polygons() {
+        if (merge_strategy == MATCHING) {
+            if (merge_priority == SEARCH_COST) {
+                matching_merge<SearchCostPriority>(true);
+            } else {
+                matching_merge<AreaPriority>(true);
+            }
+        } else {
+            if (merge_priority == SEARCH_COST) {
+                smart_merge<SearchCostPriority>(true);
+            } else {
+                smart_merge<AreaPriority>(true);
+            }
+        }
+    }
+
     void convertMesh2MergedMesh(const std::string input_filename, const std::string output_filename) {
+        TRACE_SCOPE("convertMesh2MergedMesh");
         ifstream fin(input_filename);
         ofstream fout(output_filename);
 
-        read_mesh(fin);
+        {
+            stats::Scope scope("merge.read");
+            read_mesh(fin);
+        }
+        start_merge_budget();
         // cerr << "merging dead ends" << endl;
-        merge_deadend();
+        {
+            stats::Scope scope("merge.dead_ends");
+            merge_deadend();
+        }
         // cerr << "merging" << endl;
-        smart_merge(true);
+        {
+            stats::Scope scope("merge.merge");
+            merge_polygons();
+        }
+        stats::count("merge.merges", merges_done);
         // naive_merge(true);
-        // cerr << "checking" << endl;
-        check_correct();
+        if (merge_time_limit > 0 || merge_limit > 0) {
+            report_merge_budget(cerr);
+        }
+        // the written mesh is checked with --validate instead of check_correct()
         // cerr << "outputting" << endl;
-        print_mesh(fout);
+        if (refine) {
+            stringstream merged;
+            print_mesh(merged);
+            mesh::Mesh m;
+            mesh::read_mesh(merged, m);
+            const int before = m.num_polygons();
+            int removed;
+            {
+                stats::Scope scope("merge.refine");
+                removed = meshrefine::refine(m);
+            }
+            stats::count("merge.refined_polygons", before - removed);
+            stats::Scope scope("merge.write");
+            mesh::write_mesh(fout, m);
+        } else {
+            stats::Scope scope("merge.write");
+            print_mesh(fout);
+        }
         delete_nodes();
 //    print_header();
 //    print_vertices();
@@ -0,0 +1,540 @@
+//
+// Local re-partitioning of a merged mesh into fewer convex polygons.
+//
+
+#ifndef STARTKIT_MESHREFINE_H
+#define STARTKIT_MESHREFINE_H
+/*
+Greedy merging stops when no two neighbouring polygons form a convex polygon,
+but the same area can often be cut into fewer convex pieces along different
+diagonals. Here a polygon and its neighbours form a region. The region is
+triangulated by ear clipping, from a few different starting corners, and the
+triangles are merged back greedily across diagonals while they stay convex
+(Hertel-Mehlhorn). If one of the attempts gives fewer pieces than the region
+had polygons, the pieces replace them. Only the vertices of the region are
+used, so its boundary, and everything outside it, stays as it was.
+
+Dead ends (polygons with one traversable neighbour) are left alone, as
+smart_merge does.
+*/
+#include "counters.h"
+#include "mesh.h"
+#include "predicates.h"
+#include "trace.h"
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <array>
+#include <climits>
+
+namespace meshrefine {
+    using std::vector;
+    using mesh::Mesh;
+    using mesh::Point;
+
+    // a region is a polygon and up to this many polygons in total from its neighbours
+    const int MAX_REGION_POLYGONS = 8;
+    // regions with more corners than this (not counting vertices where the boundary runs straight) are skipped
+    const int MAX_REGION_CORNERS = 24;
+    // triangulations tried per region
+    const int ATTEMPTS = 8;
+
+    inline double orient(const Point& a, const Point& b, const Point& c) {
+        return predicates::adaptive::orient2d(a.x, a.y, b.x, b.y, c.x, c.y);
+    }
+
+    // The polygons while they are being changed: the neighbour at j is across the edge (j - 1, j).
+    struct Polygons {
+        vector<vector<int>> vertices;
+        vector<vector<int>> neighbours;
+        vector<char> alive;
+    };
+
+    int num_traversable(const Polygons& polys, int p) {
+        int count = 0;
+        for(int q : polys.neighbours[p]){
+            count += q != -1;
+        }
+        return count;
+    }
+
+    // The boundary of a region, counterclockwise: loop[k] -> loop[k + 1] is an edge of one of its polygons,
+    // with outside[k] on the other side.
+    struct Region {
+        vector<int> polygons;
+        vector<int> loop;
+        vector<int> outside;
+        // positions in loop where the boundary turns, and for every position the corner at or before it
+        vector<int> corners;
+        vector<int> corner_of;
+        // positions of the vertices that can be inside an ear: reflex corners, and where the boundary runs straight
+        vector<int> blockers;
+    };
+
+    // A polygon and its non-dead-end neighbours, if their union is a simple polygon with few enough corners.
+    bool make_region(const Polygons& polys, const vector<Point>& points, int center, Region& region) {
+        region.polygons.assign(1, center);
+        for(int q : polys.neighbours[center]){
+            if((int)region.polygons.size() == MAX_REGION_POLYGONS){
+                break;
+            }
+            if(q != -1 && num_traversable(polys, q) > 1 &&
+               std::find(region.polygons.begin(), region.polygons.end(), q) == region.polygons.end()){
+                region.polygons.push_back(q);
+            }
+        }
+        if(region.polygons.size() < 3){
+            return false;
+        }
+        auto in_region = [&](int q){
+            return q != -1 && std::find(region.polygons.begin(), region.polygons.end(), q) != region.polygons.end();
+        };
+
+        // boundary edges (from, to, outside)
+        vector<std::array<int, 3>> edges;
+        for(int p : region.polygons){
+            const vector<int>& v = polys.vertices[p];
+            const int n = v.size();
+            for(int j = 0; j < n; j++){
+                const int q = polys.neighbours[p][j];
+                if(!in_region(q)){
+                    edges.push_back({v[(j + n - 1) % n], v[j], q});
+                }
+            }
+        }
+        // chain them; a vertex starting two edges is a pinch, and edges left over are a hole
+        std::sort(edges.begin(), edges.end());
+        for(size_t i = 1; i < edges.size(); i++){
+            if(edges[i][0] == edges[i - 1][0]){
+                return false;
+            }
+        }
+        region.loop.clear();
+        region.outside.clear();
+        int from = edges[0][0];
+        do{
+            auto it = std::lower_bound(edges.begin(), edges.end(), std::array<int, 3>{from, INT_MIN, INT_MIN});
+            if(it == edges.end() || (*it)[0] != from || region.loop.size() == edges.size()){
+                return false;
+            }
+            region.loop.push_back(from);
+            region.outside.push_back((*it)[2]);
+            from = (*it)[1];
+        }while(from != edges[0][0]);
+        if(region.loop.size() != edges.size()){
+            return false;
+        }
+        // every vertex of the region must be on the boundary, or it would be lost
+        for(int p : region.polygons){
+            for(int v : polys.vertices[p]){
+                if(std::find(region.loop.begin(), region.loop.end(), v) == region.loop.end()){
+                    return false;
+                }
+            }
+        }
+
+        const int n = region.loop.size();
+        region.corners.clear();
+        region.blockers.clear();
+        for(int k = 0; k < n; k++){
+            const double turn = orient(points[region.loop[(k + n - 1) % n]], points[region.loop[k]],
+                                       points[region.loop[(k + 1) % n]]);
+            if(turn != 0){
+                region.corners.push_back(k);
+            }
+            if(turn <= 0){
+                region.blockers.push_back(k);
+            }
+        }
+        const int c = region.corners.size();
+        const int reflex = region.blockers.size() - (n - c);
+        // every diagonal removes at most two reflex corners, so at least reflex / 2 + 1 pieces are needed
+        if(c < 3 || c > MAX_REGION_CORNERS || (reflex + 1) / 2 + 1 >= (int)region.polygons.size()){
+            return false;
+        }
+        region.corner_of.assign(n, 0);
+        int corner = region.corners[0];
+        for(int i = 0, k = region.corners[0]; i < n; i++, k = (k + 1) % n){
+            if(std::binary_search(region.corners.begin(), region.corners.end(), k)){
+                corner = k;
+            }
+            region.corner_of[k] = corner;
+        }
+        return true;
+    }
+
+    // Triangulate the region's corners by ear clipping, starting the search at corner `start`.
+    // Triangles are triples of corner numbers.
+    bool triangulate(const Region& region, const vector<Point>& points, int start, vector<std::array<int, 3>>& out) {
+        const int c = region.corners.size();
+        auto point = [&](int corner){ return points[region.loop[region.corners[corner]]]; };
+        const vector<int>& blockers = region.blockers;
+        // may the boundary vertex at k be on the side (a, b) of an ear?
+        auto on_own_side = [&](int k, int a, int b){
+            return b == (a + 1) % c && region.corner_of[k] == region.corners[a];
+        };
+
+        vector<int> ring;
+        for(int i = 0; i < c; i++){
+            ring.push_back((start + i) % c);
+        }
+        out.clear();
+        size_t i = 0, failed = 0;
+        while(ring.size() > 3){
+            if(failed == ring.size()){
+                return false;
+            }
+            const int a = ring[(i + ring.size() - 1) % ring.size()], b = ring[i], d = ring[(i + 1) % ring.size()];
+            bool ear = orient(point(a), point(b), point(d)) > 0;
+            for(size_t j = 0; j < blockers.size() && ear; j++){
+                const int k = blockers[j];
+                const int v = region.loop[k];
+                if(v == region.loop[region.corners[a]] || v == region.loop[region.corners[b]] ||
+                   v == region.loop[region.corners[d]]){
+                    continue;
+                }
+                const double o1 = orient(point(a), point(b), points[v]);
+                const double o2 = orient(point(b), point(d), points[v]);
+                const double o3 = orient(point(d), point(a), points[v]);
+                if(o1 < 0 || o2 < 0 || o3 < 0){
+                    continue;
+                }
+                ear = (o1 == 0 && on_own_side(k, a, b)) || (o2 == 0 && on_own_side(k, b, d));
+            }
+            if(!ear){
+                i = (i + 1) % ring.size();
+                failed++;
+                continue;
+            }
+            out.push_back({a, b, d});
+            ring.erase(ring.begin() + i);
+            i = i % ring.size();
+            failed = 0;
+        }
+        out.push_back({ring[0], ring[1], ring[2]});
+        return true;
+    }
+
+    // Merge triangles across their diagonals while the result stays convex, largest area first.
+    // Pieces are cycles of corner numbers.
+    void merge_pieces(const Region& region, const vector<Point>& points, const vector<std::array<int, 3>>& triangles,
+                      vector<vector<int>>& pieces) {
+        auto point = [&](int corner){ return points[region.loop[region.corners[corner]]]; };
+        pieces.clear();
+        vector<double> area;
+        for(const auto& t : triangles){
+            pieces.push_back({t[0], t[1], t[2]});
+            area.push_back(orient(point(t[0]), point(t[1]), point(t[2])));
+        }
+        const int c = region.corners.size();
+        while(true){
+            int best_x = -1, best_y = -1, best_i = 0, best_j = 0;
+            double best_area = -1;
+            for(int x = 0; x < (int)pieces.size(); x++){
+                const vector<int>& X = pieces[x];
+                for(int i = 0; i < (int)X.size(); i++){
+                    const int a = X[i], b = X[(i + 1) % X.size()];
+                    if(b == (a + 1) % c){
+                        continue; // boundary
+                    }
+                    for(int y = x + 1; y < (int)pieces.size(); y++){
+                        const vector<int>& Y = pieces[y];
+                        for(int j = 0; j < (int)Y.size(); j++){
+                            if(Y[j] != b || Y[(j + 1) % Y.size()] != a){
+                                continue;
+                            }
+                            // corners a and b of the merged piece
+                            const int before_a = X[(i + X.size() - 1) % X.size()];
+                            const int after_a = Y[(j + 2) % Y.size()];
+                            const int before_b = Y[(j + Y.size() - 1) % Y.size()];
+                            const int after_b = X[(i + 2) % X.size()];
+                            if(orient(point(before_a), point(a), point(after_a)) >= 0 &&
+                               orient(point(before_b), point(b), point(after_b)) >= 0 &&
+                               area[x] + area[y] > best_area){
+                                best_area = area[x] + area[y];
+                                best_x = x, best_y = y, best_i = i, best_j = j;
+                            }
+                        }
+                    }
+                }
+            }
+            if(best_x == -1){
+                return;
+            }
+            // X up to a, then Y from after a round to b, then X from after b
+            const vector<int> X = pieces[best_x], Y = pieces[best_y];
+            vector<int> merged;
+            for(int k = 0; k < (int)X.size(); k++){
+                merged.push_back(X[(best_i + 1 + k) % X.size()]); // b, ..., a
+                if(k == (int)X.size() - 1){
+                    for(int l = 2; l < (int)Y.size(); l++){
+                        merged.push_back(Y[(best_j + l) % Y.size()]);
+                    }
+                }
+            }
+            pieces[best_x] = merged;
+            area[best_x] = best_area;
+            pieces.erase(pieces.begin() + best_y);
+            area.erase(area.begin() + best_y);
+        }
+    }
+
+    // Replace the region's polygons by the pieces, re-using their indices, and link everything up.
+    void replace(Polygons& polys, const Region& region, const vector<vector<int>>& pieces, vector<char>& touched) {
+        const int n = region.loop.size(), c = region.corners.size();
+        // pieces as positions in the loop, putting back the vertices where the boundary runs straight
+        vector<vector<int>> cycles;
+        for(const auto& piece : pieces){
+            vector<int> cycle;
+            for(int i = 0; i < (int)piece.size(); i++){
+                const int a = piece[i], b = piece[(i + 1) % piece.size()];
+                cycle.push_back(region.corners[a]);
+                if(b == (a + 1) % c){
+                    for(int k = (region.corners[a] + 1) % n; k != region.corners[b]; k = (k + 1) % n){
+                        cycle.push_back(k);
+                    }
+                }
+            }
+            cycles.push_back(cycle);
+        }
+
+        // owner of every boundary edge and every diagonal side, keyed by the position it starts at
+        vector<int> boundary_owner(n, -1);
+        vector<std::array<int, 3>> sides; // (from, to, piece)
+        for(int x = 0; x < (int)cycles.size(); x++){
+            const vector<int>& cycle = cycles[x];
+            for(int i = 0; i < (int)cycle.size(); i++){
+                const int k = cycle[i], l = cycle[(i + 1) % cycle.size()];
+                if(l == (k + 1) % n){
+                    boundary_owner[k] = region.polygons[x];
+                }else{
+                    sides.push_back({k, l, region.polygons[x]});
+                }
+            }
+        }
+        std::sort(sides.begin(), sides.end());
+
+        for(int x = 0; x < (int)cycles.size(); x++){
+            const int p = region.polygons[x];
+            const vector<int>& cycle = cycles[x];
+            vector<int>& vertices = polys.vertices[p];
+            vector<int>& neighbours = polys.neighbours[p];
+            vertices.clear();
+            neighbours.clear();
+            for(int i = 0; i < (int)cycle.size(); i++){
+                const int k = cycle[(i + cycle.size() - 1) % cycle.size()], l = cycle[i];
+                vertices.push_back(region.loop[l]);
+                if(l == (k + 1) % n){
+                    neighbours.push_back(region.outside[k]);
+                }else{
+                    auto it = std::lower_bound(sides.begin(), sides.end(), std::array<int, 3>{l, k, INT_MIN});
+                    neighbours.push_back((*it)[2]);
+                }
+            }
+        }
+        for(int x = cycles.size(); x < (int)region.polygons.size(); x++){
+            const int p = region.polygons[x];
+            polys.vertices[p].clear();
+            polys.neighbours[p].clear();
+            polys.alive[p] = false;
+        }
+
+        // the polygons outside now see the new pieces across the boundary
+        for(int k = 0; k < n; k++){
+            touched[region.loop[k]] = true;
+            const int q = region.outside[k];
+            if(q == -1){
+                continue;
+            }
+            const vector<int>& v = polys.vertices[q];
+            const int m = v.size();
+            for(int j = 0; j < m; j++){
+                if(v[j] == region.loop[k] && v[(j + m - 1) % m] == region.loop[(k + 1) % n]){
+                    polys.neighbours[q][j] = boundary_owner[k];
+                }
+            }
+        }
+    }
+
+    // The polygons around a vertex, counterclockwise, with -1 for every gap between them.
+    void make_ring(const vector<Point>& points, int v, vector<std::array<int, 3>>& sectors, vector<int>& ring) {
+        // sectors are (polygon, next vertex, previous vertex): the polygon covers the angle from
+        // the direction to the next vertex counterclockwise to the direction to the previous one
+        ring.clear();
+        vector<char> used(sectors.size(), false);
+        auto starts_after = [&](int s){
+            for(int t = 0; t < (int)sectors.size(); t++){
+                if(!used[t] && sectors[t][1] == sectors[s][2]){
+                    return t;
+                }
+            }
+            return -1;
+        };
+        auto angle = [&](int w){
+            return std::atan2(points[w].y - points[v].y, points[w].x - points[v].x);
+        };
+        // begin after a gap if there is one
+        int s = 0;
+        for(int t = 0; t < (int)sectors.size(); t++){
+            bool follows = false;
+            for(const auto& other : sectors){
+                follows = follows || other[2] == sectors[t][1];
+            }
+            if(!follows){
+                s = t;
+                break;
+            }
+        }
+        const int first = s;
+        for(size_t count = 0; count < sectors.size(); count++){
+            used[s] = true;
+            ring.push_back(sectors[s][0]);
+            int t = starts_after(s);
+            if(t == -1){
+                if(sectors[first][1] != sectors[s][2]){
+                    ring.push_back(-1);
+                }
+                // the next sector counterclockwise across the gap
+                const double from = angle(sectors[s][2]);
+                double best = 10;
+                for(int u = 0; u < (int)sectors.size(); u++){
+                    if(used[u]){
+                        continue;
+                    }
+                    double turn = angle(sectors[u][1]) - from;
+                    while(turn <= 0){
+                        turn += 2 * M_PI;
+                    }
+                    if(turn < best){
+                        best = turn;
+                        t = u;
+                    }
+                }
+            }
+            if(t == -1){
+                break;
+            }
+            s = t;
+        }
+    }
+
+    // Re-partition regions of the mesh while that removes polygons. Returns how many polygons were removed.
+    int refine(Mesh& m) {
+        TRACE_SCOPE("refine");
+        const int V = m.num_vertices(), P = m.num_polygons();
+        Polygons polys;
+        polys.vertices.resize(P);
+        polys.neighbours.resize(P);
+        polys.alive.assign(P, true);
+        for(int p = 0; p < P; p++){
+            polys.vertices[p].assign(m.polygon_vertices.begin() + m.polygon_start[p],
+                                     m.polygon_vertices.begin() + m.polygon_start[p + 1]);
+            polys.neighbours[p].assign(m.polygon_neighbours.begin() + m.polygon_start[p],
+                                       m.polygon_neighbours.begin() + m.polygon_start[p + 1]);
+        }
+
+        // every polygon is tried once, and again when a region next to it changed
+        vector<int> worklist(P);
+        for(int p = 0; p < P; p++){
+            worklist[p] = P - 1 - p;
+        }
+        vector<char> queued(P, true);
+        vector<char> touched(V, false);
+        Region region;
+        vector<std::array<int, 3>> triangles;
+        vector<vector<int>> pieces, best;
+        int removed = 0;
+        while(!worklist.empty()){
+            const int p = worklist.back();
+            worklist.pop_back();
+            queued[p] = false;
+            if(!polys.alive[p] || num_traversable(polys, p) <= 1 || !make_region(polys, m.points, p, region)){
+                continue;
+            }
+            const int c = region.corners.size();
+            const int attempts = std::min(ATTEMPTS, c);
+            best.clear();
+            for(int a = 0; a < attempts; a++){
+                if(!triangulate(region, m.points, a * c / attempts, triangles)){
+                    continue;
+                }
+                merge_pieces(region, m.points, triangles, pieces);
+                if(best.empty() || pieces.size() < best.size()){
+                    best = pieces;
+                }
+            }
+            if(best.empty() || best.size() >= region.polygons.size()){
+                continue;
+            }
+            removed += region.polygons.size() - best.size();
+            replace(polys, region, best, touched);
+            for(size_t x = 0; x < best.size(); x++){
+                const int q = region.polygons[x];
+                for(int r : polys.neighbours[q]){
+                    if(r != -1 && !queued[r]){
+                        queued[r] = true;
+                        worklist.push_back(r);
+                    }
+                }
+                if(!queued[q]){
+                    queued[q] = true;
+                    worklist.push_back(q);
+                }
+            }
+        }
+        if(removed == 0){
+            return 0;
+        }
+
+        // number the polygons left, and rebuild the rings of the vertices whose polygons changed
+        vector<int> index(P, -1);
+        int next = 0;
+        for(int p = 0; p < P; p++){
+            if(polys.alive[p]){
+                index[p] = next++;
+            }
+        }
+        vector<vector<std::array<int, 3>>> sectors(V);
+        for(int p = 0; p < P; p++){
+            const vector<int>& v = polys.vertices[p];
+            const int n = v.size();
+            for(int j = 0; j < n; j++){
+                if(touched[v[j]]){
+                    sectors[v[j]].push_back({p, v[(j + 1) % n], v[(j + n - 1) % n]});
+                }
+            }
+        }
+        vector<int> vertex_start(1, 0), vertex_polygons, ring;
+        for(int v = 0; v < V; v++){
+            if(touched[v]){
+                make_ring(m.points, v, sectors[v], ring);
+            }else{
+                ring.assign(m.vertex_polygons.begin() + m.vertex_start[v],
+                            m.vertex_polygons.begin() + m.vertex_start[v + 1]);
+            }
+            for(int q : ring){
+                vertex_polygons.push_back(q == -1 ? -1 : index[q]);
+            }
+            vertex_start.push_back(vertex_polygons.size());
+        }
+        m.vertex_start.swap(vertex_start);
+        m.vertex_polygons.swap(vertex_polygons);
+
+        m.polygon_start.assign(1, 0);
+        m.polygon_vertices.clear();
+        m.polygon_neighbours.clear();
+        for(int p = 0; p < P; p++){
+            if(!polys.alive[p]){
+                continue;
+            }
+            m.polygon_vertices.insert(m.polygon_vertices.end(), polys.vertices[p].begin(), polys.vertices[p].end());
+            for(int q : polys.neighbours[p]){
+                m.polygon_neighbours.push_back(q == -1 ? -1 : index[q]);
+            }
+            m.polygon_start.push_back(m.polygon_vertices.size());
+        }
+        return removed;
+    }
+}
+
+#endif //STARTKIT_MESHREFINE_H
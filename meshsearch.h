@@ -0,0 +1,684 @@
+//
+// Replays the queries of a .scen file on a mesh, to compare meshes by how costly they are to search.
+//
+
+#ifndef STARTKIT_MESHSEARCH_H
+#define STARTKIT_MESHSEARCH_H
+/*
+The default search is Polyanya (Cui, Harabor and Grastien, IJCAI 2017): an
+optimal any-angle search whose nodes are a root point, where the path last
+turned, and an interval of a polygon edge that is visible from it. Expanding
+a node projects the interval through the polygon behind it onto that
+polygon's other edges; the path may only turn at corners, mesh vertices next
+to an obstacle. A node's f is g to the root plus the shortest distance from
+the root through the interval to the goal (mirrored across the interval if
+it is on the root's side).
+
+The corridor search is a plain A* over the polygons: a polygon is entered at
+the midpoint of the edge it is entered through, and the path runs from
+midpoint to midpoint. It is not optimal, but cheaper per polygon.
+
+Scenario coordinates are grid cells; a query runs between the cell centres.
+*/
+#include "counters.h"
+#include "mesh.h"
+#include "predicates.h"
+#include <vector>
+#include <string>
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+#include <queue>
+#include <unordered_set>
+#include <cmath>
+#include <chrono>
+#include <cstdio>
+
+namespace meshsearch {
+    using std::vector;
+    using std::string;
+    using mesh::Mesh;
+    using mesh::Point;
+
+    struct Query {
+        Point start, goal;
+        // the length the scenario gives for the (8-connected grid) path
+        double optimal;
+    };
+
+    // Read a MovingAI scenario file ("version 1", then one query per line).
+    vector<Query> read_scenario(const string& filename) {
+        std::ifstream infile(filename);
+        if(!infile){
+            mesh::fail("Error opening " + filename);
+        }
+        string word;
+        double version;
+        if(!(infile >> word >> version) || word != "version"){
+            mesh::fail("Invalid scenario header (expecting 'version')");
+        }
+        vector<Query> queries;
+        int bucket, width, height, sx, sy, gx, gy;
+        string map;
+        double optimal;
+        while(infile >> bucket >> map >> width >> height >> sx >> sy >> gx >> gy >> optimal){
+            queries.push_back({{sx + 0.5, sy + 0.5}, {gx + 0.5, gy + 0.5}, optimal});
+        }
+        return queries;
+    }
+
+    inline double distance(const Point& a, const Point& b) {
+        return std::hypot(a.x - b.x, a.y - b.y);
+    }
+
+    // Finds the polygon containing a point, through a uniform grid of buckets over the mesh that lists the
+    // polygons whose bounding box overlaps each bucket.
+    class Locator {
+    public:
+        explicit Locator(const Mesh& m) : m(m) {
+            min_x = max_x = m.points[0].x;
+            min_y = max_y = m.points[0].y;
+            for(const Point& p : m.points){
+                min_x = std::min(min_x, p.x);
+                max_x = std::max(max_x, p.x);
+                min_y = std::min(min_y, p.y);
+                max_y = std::max(max_y, p.y);
+            }
+            // about one polygon per bucket
+            side = std::max(1, (int)std::sqrt((double)m.num_polygons()));
+            bucket_width = std::max(max_x - min_x, max_y - min_y) / side;
+            if(bucket_width <= 0){
+                bucket_width = 1;
+            }
+            buckets.resize((size_t)side * side);
+            for(int p = 0; p < m.num_polygons(); p++){
+                double lo_x = max_x, hi_x = min_x, lo_y = max_y, hi_y = min_y;
+                for(int k = m.polygon_start[p]; k < m.polygon_start[p + 1]; k++){
+                    const Point& v = m.points[m.polygon_vertices[k]];
+                    lo_x = std::min(lo_x, v.x);
+                    hi_x = std::max(hi_x, v.x);
+                    lo_y = std::min(lo_y, v.y);
+                    hi_y = std::max(hi_y, v.y);
+                }
+                for(int by = bucket(lo_y, min_y); by <= bucket(hi_y, min_y); by++){
+                    for(int bx = bucket(lo_x, min_x); bx <= bucket(hi_x, min_x); bx++){
+                        buckets[(size_t)by * side + bx].push_back(p);
+                    }
+                }
+            }
+        }
+
+        // the polygon containing the point (or one of them, on an edge), or -1 if it is outside the mesh
+        int locate(const Point& point) const {
+            vector<int> found;
+            locate_all(point, found);
+            return found.empty() ? -1 : found[0];
+        }
+
+        // all the polygons containing the point: more than one if it is on an edge or a vertex
+        void locate_all(const Point& point, vector<int>& found) const {
+            found.clear();
+            if(point.x < min_x || point.x > max_x || point.y < min_y || point.y > max_y){
+                return;
+            }
+            for(int p : buckets[(size_t)bucket(point.y, min_y) * side + bucket(point.x, min_x)]){
+                if(contains(p, point)){
+                    found.push_back(p);
+                }
+            }
+        }
+
+    private:
+        int bucket(double c, double lo) const {
+            return std::min(side - 1, std::max(0, (int)((c - lo) / bucket_width)));
+        }
+
+        bool contains(int p, const Point& point) const {
+            const int begin = m.polygon_start[p], end = m.polygon_start[p + 1];
+            for(int k = begin; k < end; k++){
+                const Point& a = m.points[m.polygon_vertices[k]];
+                const Point& b = m.points[m.polygon_vertices[k + 1 == end ? begin : k + 1]];
+                if((b.x - a.x) * (point.y - a.y) - (b.y - a.y) * (point.x - a.x) < 0){
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        const Mesh& m;
+        double min_x, max_x, min_y, max_y, bucket_width;
+        int side;
+        vector<vector<int>> buckets;
+    };
+
+    struct Result {
+        bool found = false;
+        double length = 0;
+        // polygons taken off the open list, neighbours pushed onto it, and vertices of the expanded polygons
+        long long expanded = 0;
+        long long generated = 0;
+        long long vertices_scanned = 0;
+    };
+
+    // A* from polygon to polygon. The per-polygon arrays are reused between queries; a polygon's entries only
+    // count when its stamp is the current query's.
+    class CorridorSearch {
+    public:
+        explicit CorridorSearch(const Mesh& m) :
+                m(m), g(m.num_polygons()), entry(m.num_polygons()), stamp(m.num_polygons(), 0),
+                closed(m.num_polygons(), 0) {}
+
+        Result search(int start_polygon, const Point& start, int goal_polygon, const Point& goal) {
+            Result result;
+            query++;
+            typedef std::pair<double, int> Node;
+            std::priority_queue<Node, vector<Node>, std::greater<Node>> open;
+            reach(start_polygon, 0, start);
+            open.push({distance(start, goal), start_polygon});
+            while(!open.empty()){
+                const int p = open.top().second;
+                open.pop();
+                if(closed[p] == query){
+                    continue;
+                }
+                closed[p] = query;
+                result.expanded++;
+                if(p == goal_polygon){
+                    result.found = true;
+                    result.length = g[p] + distance(entry[p], goal);
+                    break;
+                }
+                const int begin = m.polygon_start[p], end = m.polygon_start[p + 1];
+                result.vertices_scanned += end - begin;
+                for(int k = begin; k < end; k++){
+                    // the neighbour at k is across the edge (k - 1, k)
+                    const int q = m.polygon_neighbours[k];
+                    if(q == -1 || closed[q] == query){
+                        continue;
+                    }
+                    const Point& a = m.points[m.polygon_vertices[k == begin ? end - 1 : k - 1]];
+                    const Point& b = m.points[m.polygon_vertices[k]];
+                    const Point mid = {(a.x + b.x) / 2, (a.y + b.y) / 2};
+                    const double cost = g[p] + distance(entry[p], mid);
+                    if(stamp[q] != query || cost < g[q]){
+                        reach(q, cost, mid);
+                        open.push({cost + distance(mid, goal), q});
+                        result.generated++;
+                    }
+                }
+            }
+            return result;
+        }
+
+    private:
+        void reach(int p, double cost, const Point& at) {
+            stamp[p] = query;
+            g[p] = cost;
+            entry[p] = at;
+        }
+
+        const Mesh& m;
+        vector<double> g;
+        vector<Point> entry;
+        vector<int> stamp;
+        vector<int> closed;
+        int query = 0;
+    };
+
+    inline double orient(const Point& a, const Point& b, const Point& c) {
+        return predicates::adaptive::orient2d(a.x, a.y, b.x, b.y, c.x, c.y);
+    }
+
+    // Where the segment p q crosses a line, given orient() of p and of q against the line, of different signs.
+    inline Point crossing(const Point& p, double p_side, const Point& q, double q_side) {
+        const double t = p_side / (p_side - q_side);
+        return {p.x + t * (q.x - p.x), p.y + t * (q.y - p.y)};
+    }
+
+    inline bool on_segment(const Point& x, const Point& p, const Point& q) {
+        return orient(p, q, x) == 0 && std::min(p.x, q.x) <= x.x && x.x <= std::max(p.x, q.x) &&
+               std::min(p.y, q.y) <= x.y && x.y <= std::max(p.y, q.y);
+    }
+
+    class Polyanya {
+    public:
+        explicit Polyanya(const Mesh& m) :
+                m(m), corner(m.num_vertices(), 0), wall_before(m.num_vertices(), -1),
+                wall_after(m.num_vertices(), -1), root_g(m.num_vertices()), root_stamp(m.num_vertices(), 0) {
+            // A taut path only turns where an obstacle sticks out into the free space: at a vertex whose free
+            // space, from the boundary edge to wall_after counterclockwise round to the boundary edge to
+            // wall_before, spans more than half a turn. A vertex between several obstacles may be such a vertex
+            // between any two of them, and keeps -1 for both.
+            for(int p = 0; p < m.num_polygons(); p++){
+                const int begin = m.polygon_start[p], n = m.polygon_start[p + 1] - begin;
+                for(int j = 0; j < n; j++){
+                    const int v = m.polygon_vertices[begin + j];
+                    if(m.polygon_neighbours[begin + j] == -1){
+                        wall_before[v] = m.polygon_vertices[begin + (j + n - 1) % n];
+                    }
+                    if(m.polygon_neighbours[begin + (j + 1) % n] == -1){
+                        wall_after[v] = m.polygon_vertices[begin + (j + 1) % n];
+                    }
+                }
+            }
+            for(int v = 0; v < m.num_vertices(); v++){
+                const int gaps = (int)std::count(m.vertex_polygons.begin() + m.vertex_start[v],
+                                                 m.vertex_polygons.begin() + m.vertex_start[v + 1], -1);
+                if(gaps > 1){
+                    corner[v] = true;
+                    wall_before[v] = wall_after[v] = -1;
+                }else if(gaps == 1){
+                    corner[v] = orient(m.points[v], m.points[wall_after[v]], m.points[wall_before[v]]) < 0;
+                }
+            }
+        }
+
+        Result search(const vector<int>& start_polygons, const Point& start,
+                      const vector<int>& goal_polygons, const Point& goal) {
+            Result result;
+            query++;
+            this->goal = goal;
+            this->goal_polygons = &goal_polygons;
+            this->result = &result;
+            open = std::priority_queue<Node>();
+            expanded_nodes.clear();
+
+            for(int s : start_polygons){
+                if(is_goal_polygon(s)){
+                    result.found = true;
+                    result.length = distance(start, goal);
+                    return result;
+                }
+            }
+            for(int s : start_polygons){
+                const int begin = m.polygon_start[s], end = m.polygon_start[s + 1];
+                for(int k = begin; k < end; k++){
+                    const int p = m.polygon_vertices[k == begin ? end - 1 : k - 1], q = m.polygon_vertices[k];
+                    // an edge the start is on leads to a polygon that also contains the start
+                    if(!on_segment(start, m.points[p], m.points[q])){
+                        push(start, -1, 0, p, m.points[p], p, m.points[q], q, m.polygon_neighbours[k]);
+                    }
+                }
+            }
+
+            while(!open.empty()){
+                const Node node = open.top();
+                open.pop();
+                if(node.polygon == -1){
+                    result.found = true;
+                    result.length = node.g;
+                    break;
+                }
+                if(node.root_vertex != -1 && node.g > root_g[node.root_vertex] + EPSILON){
+                    continue;
+                }
+                // paths of the same length round different sides of an obstacle reach the same corner, and
+                // then queue the same nodes; only the first of them is expanded
+                if(!expanded_nodes.insert(node).second){
+                    continue;
+                }
+                result.expanded++;
+                expand(node);
+            }
+            return result;
+        }
+
+    private:
+        const double EPSILON = 1e-8;
+
+        struct Node {
+            double f, g;
+            // where the path last turned: the start (root_vertex -1) or a corner
+            Point root;
+            int root_vertex;
+            // the part of an edge the path goes through next, as seen from the root; at each end, the mesh
+            // vertex that end is on, or -1
+            Point right, left;
+            int right_vertex, left_vertex;
+            // the polygon behind the interval, which it enters through the edge whose right end is
+            // edge_right, or -1 for a path that ends at the goal
+            int polygon;
+            int edge_right;
+
+            bool operator<(const Node& other) const {
+                return f != other.f ? f > other.f : g < other.g;
+            }
+        };
+
+        // Nodes are the same if they have the same root and interval; the one with the lowest g comes first.
+        struct SameNode {
+            bool operator()(const Node& a, const Node& b) const {
+                return a.root_vertex == b.root_vertex && a.polygon == b.polygon && a.root.x == b.root.x &&
+                       a.root.y == b.root.y && a.right.x == b.right.x && a.right.y == b.right.y &&
+                       a.left.x == b.left.x && a.left.y == b.left.y;
+            }
+        };
+        struct NodeHash {
+            size_t operator()(const Node& n) const {
+                const std::hash<double> h;
+                size_t seed = std::hash<int>()(n.polygon) * 31 + std::hash<int>()(n.root_vertex);
+                for(double x : {n.root.x, n.root.y, n.right.x, n.right.y, n.left.x, n.left.y}){
+                    seed ^= h(x) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+                }
+                return seed;
+            }
+        };
+
+        // orient(), but 0 for a c that is within EPSILON of the line through a and b: the ends of an interval
+        // are rounded, and a ray through one that should pass through a vertex may miss it by a little.
+        double side(const Point& a, const Point& b, const Point& c) const {
+            const double o = orient(a, b, c);
+            return std::abs(o) <= EPSILON * distance(a, b) ? 0 : o;
+        }
+
+        bool is_goal_polygon(int p) const {
+            return std::find(goal_polygons->begin(), goal_polygons->end(), p) != goal_polygons->end();
+        }
+
+        // Coming from root, a path can turn round corner v to the right (hand -1) or left (hand 1) only if the
+        // obstacle there is on that side of it.
+        bool turns(const Point& root, int v, int hand) const {
+            if(v == -1 || !corner[v]){
+                return false;
+            }
+            if(wall_before[v] == -1){
+                return true;
+            }
+            const Point& at = m.points[v];
+            return orient(root, at, m.points[wall_before[v]]) * hand >= 0 &&
+                   orient(root, at, m.points[wall_after[v]]) * hand >= 0;
+        }
+
+        // A path may turn at a corner only if it does not get there more cheaply another way.
+        bool improves_root(int v, double g) {
+            if(root_stamp[v] == query && g > root_g[v] + EPSILON){
+                return false;
+            }
+            if(root_stamp[v] != query || g < root_g[v]){
+                root_stamp[v] = query;
+                root_g[v] = g;
+            }
+            return true;
+        }
+
+        // The shortest distance from the root through the interval to the goal.
+        double heuristic(const Point& root, const Point& right, const Point& left) const {
+            Point target = goal;
+            const double root_side = orient(right, left, root), goal_side = orient(right, left, goal);
+            if((root_side > 0 && goal_side > 0) || (root_side < 0 && goal_side < 0)){
+                const double dx = left.x - right.x, dy = left.y - right.y;
+                const double t = ((goal.x - right.x) * dx + (goal.y - right.y) * dy) / (dx * dx + dy * dy);
+                target = {2 * (right.x + t * dx) - goal.x, 2 * (right.y + t * dy) - goal.y};
+            }
+            const double right_side = orient(root, target, right), left_side = orient(root, target, left);
+            if((right_side <= 0 && left_side >= 0) || (right_side >= 0 && left_side <= 0)){
+                return distance(root, target);
+            }
+            return std::min(distance(root, right) + distance(right, target),
+                            distance(root, left) + distance(left, target));
+        }
+
+        // Queue the interval from right to left of an edge of the polygon being expanded, which leads to the
+        // polygon `next`. p is the end of the edge on the right; right_vertex and left_vertex are the mesh
+        // vertices the ends of the interval are on, or -1.
+        void push(const Point& root, int root_vertex, double g, int p,
+                  const Point& right, int right_vertex, const Point& left, int left_vertex, int next) {
+            if(next == -1){
+                return;
+            }
+            // the root itself: the polygons around it are reached through the edges that end at it
+            if(root_vertex != -1 && right_vertex == root_vertex && left_vertex == root_vertex){
+                return;
+            }
+            // Seen edge on, or a single point, the interval can only be reached at its near end. Past that the
+            // path has to turn, which it can do at a corner; the node then sweeps round that corner.
+            if(side(root, right, left) == 0 && (root_vertex == -1 || (root_vertex != right_vertex &&
+                                                                        root_vertex != left_vertex))){
+                const bool right_nearer = distance(root, right) <= distance(root, left);
+                const int near = right_nearer ? right_vertex : left_vertex;
+                if(near == -1 || !corner[near]){
+                    return;
+                }
+                const Point& turn = right_nearer ? right : left;
+                g += distance(root, turn);
+                if(!improves_root(near, g)){
+                    return;
+                }
+                push(turn, near, g, p, right, right_vertex, left, left_vertex, next);
+                return;
+            }
+            Node node;
+            node.g = g;
+            node.f = g + heuristic(root, right, left);
+            node.root = root;
+            node.root_vertex = root_vertex;
+            node.right = right;
+            node.left = left;
+            node.right_vertex = right_vertex;
+            node.left_vertex = left_vertex;
+            node.polygon = next;
+            node.edge_right = p;
+            open.push(node);
+            result->generated++;
+        }
+
+        void push_goal(double length) {
+            Node node;
+            node.f = node.g = length;
+            node.polygon = -1;
+            open.push(node);
+            result->generated++;
+        }
+
+        void expand(const Node& node) {
+            const int begin = m.polygon_start[node.polygon];
+            const int n = m.polygon_start[node.polygon + 1] - begin;
+            result->vertices_scanned += n;
+            int entry = 0;
+            while(m.polygon_vertices[begin + entry] != node.edge_right){
+                entry++;
+            }
+            // the boundary from the right end of the entry edge, vertex(0), round to its left end, vertex(n - 1);
+            // the edge (i - 1, i) leads to neighbour(i)
+            auto vertex = [&](int i){ return m.polygon_vertices[begin + (entry + i) % n]; };
+            auto neighbour = [&](int i){ return m.polygon_neighbours[begin + (entry + i) % n]; };
+            auto point = [&](int i) -> const Point& { return m.points[vertex(i)]; };
+            const Point& root = node.root;
+
+            // a root on the entry edge sees the whole polygon
+            const bool sees_all = orient(point(n - 1), point(0), root) == 0;
+
+            if(is_goal_polygon(node.polygon)){
+                if(sees_all){
+                    push_goal(node.g + distance(root, goal));
+                    return;
+                }
+                const double right_side = side(root, node.right, goal), left_side = side(root, node.left, goal);
+                if(right_side >= 0 && left_side <= 0){
+                    push_goal(node.g + distance(root, goal));
+                    return;
+                }
+                if(right_side < 0 && turns(root, node.right_vertex, -1)){
+                    push_goal(node.g + distance(root, node.right) + distance(node.right, goal));
+                    return;
+                }
+                if(left_side > 0 && turns(root, node.left_vertex, 1)){
+                    push_goal(node.g + distance(root, node.left) + distance(node.left, goal));
+                    return;
+                }
+            }
+
+            if(sees_all){
+                for(int i = 1; i < n; i++){
+                    push(root, node.root_vertex, node.g, vertex(i - 1),
+                         point(i - 1), vertex(i - 1), point(i), vertex(i), neighbour(i));
+                }
+                return;
+            }
+
+            // Where the rays from the root through the ends of the interval leave the polygon, and the first
+            // edge the straight on part starts on and the last it ends on. A ray can run along the boundary for
+            // a while; the part of the boundary it runs along is taken as straight on, so that the corners on it
+            // are reached.
+            int right_edge = -1, left_edge = -1;
+            Point right_hit, left_hit;
+            int right_hit_vertex = -1, left_hit_vertex = -1;
+            double right_before = 0, left_before = 0;
+            for(int i = 0; i < n && left_edge == -1; i++){
+                const double right_side = side(root, node.right, point(i));
+                const double left_side = side(root, node.left, point(i));
+                if(right_edge == -1 && ((right_side == 0 && i > 0) || (right_side > 0 && i == 0))){
+                    right_edge = i + 1;
+                    right_hit = point(i);
+                    right_hit_vertex = vertex(i);
+                }else if(right_edge == -1 && right_side > 0){
+                    right_edge = i;
+                    right_hit = crossing(point(i - 1), right_before, point(i), right_side);
+                }
+                if(i > 0 && left_side == 0){
+                    left_edge = i;
+                    while(left_edge + 1 < n && side(root, node.left, point(left_edge + 1)) == 0){
+                        left_edge++;
+                    }
+                    left_hit = point(left_edge);
+                    left_hit_vertex = vertex(left_edge);
+                }else if(i > 0 && left_side > 0){
+                    left_edge = i;
+                    left_hit = crossing(point(i - 1), left_before, point(i), left_side);
+                }
+                right_before = right_side;
+                left_before = left_side;
+            }
+            if(right_edge == -1 || left_edge == -1 || right_edge > left_edge){
+                // only when rounding has put an end of the interval off its edge
+                return;
+            }
+
+            // observable: straight on from the root
+            for(int i = right_edge; i <= left_edge; i++){
+                push(root, node.root_vertex, node.g, vertex(i - 1),
+                     i == right_edge ? right_hit : point(i - 1), i == right_edge ? right_hit_vertex : vertex(i - 1),
+                     i == left_edge ? left_hit : point(i), i == left_edge ? left_hit_vertex : vertex(i),
+                     neighbour(i));
+            }
+            // A ray that leaves through a vertex also touches the polygon on the other side of it, which the
+            // path can turn into if the vertex is a corner.
+            if(right_hit_vertex != -1 && right_edge > 1){
+                const int i = right_edge - 1;
+                push(root, node.root_vertex, node.g, vertex(i - 1), right_hit, right_hit_vertex,
+                     right_hit, right_hit_vertex, neighbour(i));
+            }
+            if(left_hit_vertex != -1 && left_edge < n - 1){
+                const int i = left_edge + 1;
+                push(root, node.root_vertex, node.g, vertex(i - 1), left_hit, left_hit_vertex,
+                     left_hit, left_hit_vertex, neighbour(i));
+            }
+            // non-observable: turning at a corner at the right or left end of the interval
+            if(turns(root, node.right_vertex, -1)){
+                const double g = node.g + distance(root, node.right);
+                if(improves_root(node.right_vertex, g)){
+                    for(int i = 1; i <= right_edge; i++){
+                        push(node.right, node.right_vertex, g, vertex(i - 1), point(i - 1), vertex(i - 1),
+                             i == right_edge ? right_hit : point(i), i == right_edge ? right_hit_vertex : vertex(i),
+                             neighbour(i));
+                    }
+                }
+            }
+            if(turns(root, node.left_vertex, 1)){
+                const double g = node.g + distance(root, node.left);
+                if(improves_root(node.left_vertex, g)){
+                    for(int i = left_edge; i < n; i++){
+                        push(node.left, node.left_vertex, g, vertex(i - 1),
+                             i == left_edge ? left_hit : point(i - 1), i == left_edge ? left_hit_vertex : vertex(i - 1),
+                             point(i), vertex(i), neighbour(i));
+                    }
+                }
+            }
+        }
+
+        const Mesh& m;
+        vector<char> corner;
+        // at a vertex on the boundary, the vertices across the boundary edges before and after the free space
+        vector<int> wall_before, wall_after;
+        vector<double> root_g;
+        vector<int> root_stamp;
+        int query = 0;
+
+        // for the current query
+        std::priority_queue<Node> open;
+        std::unordered_set<Node, NodeHash, SameNode> expanded_nodes;
+        Point goal;
+        const vector<int>* goal_polygons = nullptr;
+        Result* result = nullptr;
+    };
+
+    double percentile(vector<double> sorted, double fraction) {
+        if(sorted.empty()){
+            return 0;
+        }
+        std::sort(sorted.begin(), sorted.end());
+        return sorted[std::min(sorted.size() - 1, (size_t)(fraction * sorted.size()))];
+    }
+
+    enum Search {POLYANYA, CORRIDOR};
+
+    // Run every query of the scenario on the mesh and print a summary. Polyanya's lengths should never be
+    // longer than the scenario's, which are for 8-connected grid paths.
+    void run_benchmark(const string& mesh_file, const string& scenario_file, Search kind = POLYANYA) {
+        Mesh m;
+        mesh::read_mesh(mesh_file, m);
+        const vector<Query> queries = read_scenario(scenario_file);
+        const Locator locator(m);
+        Polyanya polyanya(m);
+        CorridorSearch corridor(m);
+
+        long long not_located = 0, not_found = 0, shorter = 0, equal = 0, longer = 0;
+        long long expanded = 0, generated = 0, vertices_scanned = 0;
+        double length_ratio = 0;
+        vector<double> micros;
+        vector<int> starts, goals;
+        for(const Query& q : queries){
+            const auto begin = std::chrono::steady_clock::now();
+            locator.locate_all(q.start, starts);
+            locator.locate_all(q.goal, goals);
+            if(starts.empty() || goals.empty()){
+                not_located++;
+                continue;
+            }
+            const Result r = kind == POLYANYA ? polyanya.search(starts, q.start, goals, q.goal)
+                                              : corridor.search(starts[0], q.start, goals[0], q.goal);
+            micros.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - begin).count());
+            if(!r.found){
+                not_found++;
+                continue;
+            }
+            expanded += r.expanded;
+            generated += r.generated;
+            vertices_scanned += r.vertices_scanned;
+            length_ratio += q.optimal > 0 ? r.length / q.optimal : 1;
+            // scenario lengths are given to 5 decimals or so
+            const double tolerance = 1e-4 * std::max(1.0, q.optimal);
+            if(r.length < q.optimal - tolerance){
+                shorter++;
+            }else if(r.length > q.optimal + tolerance){
+                longer++;
+            }else{
+                equal++;
+            }
+        }
+
+        const long long solved = (long long)micros.size() - not_found;
+        const double per = solved > 0 ? 1.0 / solved : 0;
+        std::printf("%s: %d polygons, %zu queries, %lld solved, %lld not found, %lld outside the mesh\n",
+                    mesh_file.c_str(), m.num_polygons(), queries.size(), solved, not_found, not_located);
+        std::printf("per query: %.1f expanded, %.1f generated, %.1f vertices scanned\n",
+                    expanded * per, generated * per, vertices_scanned * per);
+        std::printf("length: %.4f x scenario on average, %lld shorter, %lld equal, %lld longer\n",
+                    length_ratio * per, shorter, equal, longer);
+        std::printf("time (us): p50 %.1f, p90 %.1f, p99 %.1f, p99.9 %.1f, max %.1f\n", percentile(micros, 0.5),
+                    percentile(micros, 0.9), percentile(micros, 0.99), percentile(micros, 0.999),
+                    percentile(micros, 1.0));
+    }
+}
+
+#endif //STARTKIT_MESHSEARCH_H
@@ -0,0 +1,220 @@
+//
+// Consistency checks of a mesh, run in parallel over its flat arrays.
+//
+
+#ifndef STARTKIT_MESHVERIFY_H
+#define STARTKIT_MESHVERIFY_H
+#include "counters.h"
+#include "mesh.h"
+#include "predicates.h"
+#include "trace.h"
+#include <vector>
+#include <string>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <iostream>
+
+namespace meshverify {
+    using std::vector;
+    using std::string;
+    using mesh::Mesh;
+
+    enum Level {OFF, SAMPLED, FULL};
+
+    // the sampled level checks about this many vertices and this many polygons, evenly spread over the mesh
+    const int SAMPLE_SIZE = 1000;
+
+    // only this many errors are described, the rest are only counted
+    const size_t MAX_REPORTED_ERRORS = 10;
+
+    struct Report {
+        size_t checked_vertices = 0;
+        size_t checked_polygons = 0;
+        size_t num_errors = 0;
+        vector<string> errors;
+
+        void error(const string& message) {
+            if(errors.size() < MAX_REPORTED_ERRORS){
+                errors.push_back(message);
+            }
+            num_errors++;
+        }
+
+        void add(const Report& other) {
+            checked_vertices += other.checked_vertices;
+            checked_polygons += other.checked_polygons;
+            num_errors += other.num_errors;
+            for(const auto& e : other.errors){
+                if(errors.size() < MAX_REPORTED_ERRORS){
+                    errors.push_back(e);
+                }
+            }
+        }
+    };
+
+    // Exact, like mesh2merged::cw.
+    inline bool cw(const mesh::Point& a, const mesh::Point& b, const mesh::Point& c) {
+        return predicates::adaptive::orient2d(a.x, a.y, b.x, b.y, c.x, c.y) < 0;
+    }
+
+    bool polygon_has_vertex(const Mesh& m, int p, int v) {
+        for(int k = m.polygon_start[p]; k < m.polygon_start[p + 1]; k++){
+            if(m.polygon_vertices[k] == v){
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool vertex_has_polygon(const Mesh& m, int v, int p) {
+        for(int k = m.vertex_start[v]; k < m.vertex_start[v + 1]; k++){
+            if(m.vertex_polygons[k] == p){
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Every polygon around a vertex has that vertex, and none appears twice.
+    void check_vertex(const Mesh& m, int v, Report& report) {
+        const int begin = m.vertex_start[v], end = m.vertex_start[v + 1];
+        for(int k = begin; k < end; k++){
+            const int p = m.vertex_polygons[k];
+            if(p == -1){
+                continue;
+            }
+            if(!polygon_has_vertex(m, p, v)){
+                report.error("vertex " + std::to_string(v) + " lists polygon " + std::to_string(p) +
+                             ", which does not have it");
+            }
+            if(std::find(m.vertex_polygons.begin() + k + 1, m.vertex_polygons.begin() + end, p) !=
+               m.vertex_polygons.begin() + end){
+                report.error("vertex " + std::to_string(v) + " lists polygon " + std::to_string(p) + " twice");
+            }
+        }
+    }
+
+    // A polygon is convex and counterclockwise, its vertices list it, and every neighbour has the shared edge
+    // the other way round with this polygon across it.
+    void check_polygon(const Mesh& m, int p, Report& report) {
+        const int begin = m.polygon_start[p], end = m.polygon_start[p + 1];
+        const int n = end - begin;
+        auto vertex = [&](int j){ return m.polygon_vertices[begin + (j + n) % n]; };
+        const string name = "polygon " + std::to_string(p);
+
+        double area = 0;
+        for(int j = 0; j < n; j++){
+            const mesh::Point& a = m.points[vertex(j)];
+            const mesh::Point& b = m.points[vertex(j + 1)];
+            area += a.x * b.y - a.y * b.x;
+            if(cw(a, b, m.points[vertex(j + 2)])){
+                report.error(name + " turns clockwise at vertex " + std::to_string(vertex(j + 1)));
+            }
+        }
+        if(area <= 0){
+            report.error(name + " does not have a positive area");
+        }
+
+        for(int j = 0; j < n; j++){
+            const int v = vertex(j);
+            if(!vertex_has_polygon(m, v, p)){
+                report.error(name + " is not listed by its vertex " + std::to_string(v));
+            }
+
+            // the neighbour at j is across the edge (j - 1, j)
+            const int q = m.polygon_neighbours[begin + j];
+            if(q == -1){
+                continue;
+            }
+            if(q == p){
+                report.error(name + " is its own neighbour");
+                continue;
+            }
+            const int u = vertex(j - 1);
+            const int q_begin = m.polygon_start[q], q_end = m.polygon_start[q + 1];
+            const int q_n = q_end - q_begin;
+            bool found = false;
+            for(int k = 0; k < q_n && !found; k++){
+                found = m.polygon_vertices[q_begin + k] == v &&
+                        m.polygon_vertices[q_begin + (k + 1) % q_n] == u &&
+                        m.polygon_neighbours[q_begin + (k + 1) % q_n] == p;
+            }
+            if(!found){
+                report.error(name + " has neighbour " + std::to_string(q) + " across edge (" +
+                             std::to_string(u) + ", " + std::to_string(v) + "), but not the other way round");
+            }
+        }
+    }
+
+    // Check the vertices and polygons the level asks for, on up to `threads` threads (0: one per hardware thread).
+    Report verify(const Mesh& m, Level level, int threads = 0) {
+        TRACE_SCOPE("verify");
+        Report report;
+        if(level == OFF){
+            return report;
+        }
+        const int V = m.num_vertices(), P = m.num_polygons();
+        // items [0, V) are vertices and [V, V + P) polygons; with sampling only every stride-th one of each
+        const int vertex_stride = level == SAMPLED ? std::max(1, V / SAMPLE_SIZE) : 1;
+        const int polygon_stride = level == SAMPLED ? std::max(1, P / SAMPLE_SIZE) : 1;
+        const int vertex_jobs = (V + vertex_stride - 1) / vertex_stride;
+        const int polygon_jobs = (P + polygon_stride - 1) / polygon_stride;
+        const int jobs = vertex_jobs + polygon_jobs;
+
+        const int chunk = 4096;
+        int workers = threads > 0 ? threads : (int)std::thread::hardware_concurrency();
+        workers = std::max(1, std::min(workers, jobs / chunk + 1));
+        vector<Report> reports(workers);
+        std::atomic<int> next(0);
+        auto worker = [&](int w){
+            TRACE_SCOPE("verify worker");
+            for(int first = next.fetch_add(chunk); first < jobs; first = next.fetch_add(chunk)){
+                const int last = std::min(jobs, first + chunk);
+                for(int job = first; job < last; job++){
+                    if(job < vertex_jobs){
+                        check_vertex(m, job * vertex_stride, reports[w]);
+                        reports[w].checked_vertices++;
+                    }else{
+                        check_polygon(m, (job - vertex_jobs) * polygon_stride, reports[w]);
+                        reports[w].checked_polygons++;
+                    }
+                }
+            }
+        };
+        vector<std::thread> pool;
+        for(int w = 1; w < workers; w++){
+            pool.emplace_back(worker, w);
+        }
+        worker(0);
+        for(auto& t : pool){
+            t.join();
+        }
+
+        for(const auto& r : reports){
+            report.add(r);
+        }
+        return report;
+    }
+
+    // Read and verify a mesh file. Prints what is wrong to stderr and returns false if anything is.
+    bool verify_file(const string& filename, Level level, int threads = 0) {
+        if(level == OFF){
+            return true;
+        }
+        Mesh m;
+        mesh::read_mesh(filename, m);
+        Report report = verify(m, level, threads);
+        for(const auto& e : report.errors){
+            std::cerr << filename << ": " << e << std::endl;
+        }
+        if(report.num_errors > 0){
+            std::cerr << filename << ": " << report.num_errors << " errors in " << report.checked_vertices
+                      << " vertices and " << report.checked_polygons << " polygons checked" << std::endl;
+            return false;
+        }
+        return true;
+    }
+}
+
+#endif //STARTKIT_MESHVERIFY_H
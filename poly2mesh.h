@@ -4,7 +4,12 @@
 
 #ifndef STARTKIT_POLY2MESH_H
 #define STARTKIT_POLY2MESH_H
+#include "counters.h"
 #include "CDT.h"
+#include "rectcdt.h"
+#include "stripcdt.h"
+#include "stats.h"
+#include "trace.h"
 #include <string>
 #include <stdlib.h>
 #include <stdio.h>
@@ -14,6 +19,15 @@
 #include <iomanip>
 #include <map>
 #include <iomanip>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <cstdint>
+#include <cmath>
+#include <array>
+#include <unordered_map>
+#include <exception>
+#include <memory>
 
 #define FORMAT_VERSION 2
 
@@ -58,14 +72,16 @@ namespace poly2mesh {
     };
 
 
-    double polarAngle(const CustomPoint2D& p, const CustomPoint2D& center) {
-        return std::atan2(p.y - center.y, p.x - center.x);
+    // Order two directions by polar angle in (-pi, pi], the order std::atan2 gives, using exact comparisons.
+    bool angle_less(double dx1, double dy1, double dx2, double dy2){
+        int half1 = (dy1 < 0 || (dy1 == 0 && dx1 > 0)) ? 0 : 1;
+        int half2 = (dy2 < 0 || (dy2 == 0 && dx2 > 0)) ? 0 : 1;
+        if(half1 != half2){
+            return half1 < half2;
+        }
+        return dx1 * dy2 - dy1 * dx2 > 0;
     }
 
-// Define a custom comparison function to compare two points based on their polar angles
-    bool compare(const CustomPoint2D& p1, const CustomPoint2D& p2, const CustomPoint2D& center) {
-        return polarAngle(p1, center) < polarAngle(p2, center);
-    }
     void fail(const string& message)
     {
         cerr << message << endl;
@@ -74,6 +90,7 @@ namespace poly2mesh {
 
     vector<CustomPoly> *read_polys(istream& infile)
     {
+        TRACE_SCOPE("read_polys");
         vector<CustomPoly> *polygons = new vector<CustomPoly>;
         string header;
         int version;
@@ -150,137 +167,561 @@ namespace poly2mesh {
     }
 
 
-    void convertPoly2Mesh(const std::string input_file,const std::string output_file, int width){
+    // number of worker threads used to triangulate components; 0 uses one per hardware thread
+    int num_threads = 0;
 
-        ifstream fin(input_file);
-        vector<CustomPoly>* polygons =  read_polys(fin);
-        vector<CustomPoint2D> vertices;
-        vector<CustomEdge> edges;
-        width = width + 1;
-        std::unordered_map<unsigned int, unsigned int> vertex_map;
-        for (auto& poly : *polygons){
+    int worker_count(size_t jobs){
+        int n = num_threads > 0 ? num_threads : (int)std::thread::hardware_concurrency();
+        if(n < 1){
+            n = 1;
+        }
+        return (int)min((size_t)n, max(jobs, (size_t)1));
+    }
+
+    // Give every distinct polygon vertex an id, in order of first appearance, and return the distinct vertices.
+    // Lattice vertices are welded through a dense (W+1)x(H+1) index when the lattice is small relative to the
+    // number of vertices, and through a radix sort of 64-bit lattice keys otherwise. Other input is welded by
+    // sorting the coordinates.
+    vector<CustomPoint2D> weld_vertices(vector<CustomPoly>& polygons){
+        TRACE_SCOPE("weld_vertices");
+        vector<CustomPoint2D*> points;
+        bool lattice = true;
+        uint64_t max_x = 0, max_y = 0;
+        for(auto& poly : polygons){
             for(auto& v : poly.vertices){
-                auto it = vertex_map.find(v.y * width + v.x);
-                if(it != vertex_map.end()){
-                    // found
-                    v.id = it->second;
+                if(v.x < 0 || v.y < 0 || v.x != std::floor(v.x) || v.y != std::floor(v.y) || v.x > 4294967295.0 || v.y > 4294967295.0){
+                    lattice = false;
                 }else{
-                    // not found
-                    vertex_map.insert(make_pair(v.y * width + v.x, vertices.size()));
-                    v.id = vertices.size();
-                    vertices.push_back(v);
+                    max_x = max(max_x, (uint64_t)v.x);
+                    max_y = max(max_y, (uint64_t)v.y);
                 }
+                points.push_back(&v);
             }
         }
+        vector<CustomPoint2D> vertices;
+        if(points.empty()){
+            return vertices;
+        }
 
-        for (auto poly : *polygons) {
-            for (auto v: poly.edges) {
-                CustomPoint2D v1 = poly.vertices[v.vertices.first];
-                CustomPoint2D v2 = poly.vertices[v.vertices.second];
-                if(v1.id == -1 || v2.id == -1){
-                    cerr<< "edge_id can not match"<< endl;
+        const uint64_t row = max_x + 1;
+        const bool dense = lattice && max_y + 1 <= (((uint64_t)1 << 31) - 1) / row &&
+                           row * (max_y + 1) <= 16 * (uint64_t)points.size() + ((uint64_t)1 << 20);
+        if(dense){
+            vector<int> index(row * (max_y + 1), -1);
+            for(auto v : points){
+                int& id = index[(uint64_t)v->y * row + (uint64_t)v->x];
+                if(id == -1){
+                    id = vertices.size();
+                    v->id = id;
+                    vertices.push_back(*v);
+                }else{
+                    v->id = id;
                 }
-                edges.push_back(CustomEdge(v1.id,v2.id));
             }
+            return vertices;
         }
 
+        // sort the occurrences by position, stably so the first occurrence of each position comes first
+        vector<uint32_t> order(points.size());
+        for(uint32_t i = 0; i < order.size(); i++){
+            order[i] = i;
+        }
+        if(lattice){
+            vector<uint64_t> keys(points.size());
+            uint64_t max_key = 0;
+            for(size_t i = 0; i < points.size(); i++){
+                keys[i] = (uint64_t)points[i]->y * row + (uint64_t)points[i]->x;
+                max_key = max(max_key, keys[i]);
+            }
+            vector<uint32_t> buffer(order.size());
+            for(int shift = 0; shift < 64 && (max_key >> shift) != 0; shift += 16){
+                vector<size_t> count((1 << 16) + 1, 0);
+                for(auto i : order){
+                    count[((keys[i] >> shift) & 0xFFFF) + 1]++;
+                }
+                for(size_t d = 1; d < count.size(); d++){
+                    count[d] += count[d - 1];
+                }
+                for(auto i : order){
+                    buffer[count[(keys[i] >> shift) & 0xFFFF]++] = i;
+                }
+                order.swap(buffer);
+            }
+        }else{
+            std::stable_sort(order.begin(), order.end(), [&points](uint32_t a, uint32_t b){
+                return points[a]->y < points[b]->y || (points[a]->y == points[b]->y && points[a]->x < points[b]->x);
+            });
+        }
 
-        CDT::Triangulation<double> cdt;
-        cdt.insertVertices(
-                vertices.begin(),
-                vertices.end(),
-                [](const CustomPoint2D& p){ return p.x; },
-                [](const CustomPoint2D& p){ return p.y; }
-        );
-        cdt.insertEdges(
-                edges.begin(),
-                edges.end(),
-                [](const CustomEdge& e){ return e.vertices.first; },
-                [](const CustomEdge& e){ return e.vertices.second; }
-        );
-        cdt.eraseOuterTrianglesAndHoles();
-        auto triangles = cdt.triangles;
-        if(triangles.empty()){
-            cerr<<"Error: generating CDT failed "<<endl;
-        };
+        vector<uint32_t> first(points.size());
+        for(size_t j = 0; j < order.size(); j++){
+            bool same = j > 0 && *points[order[j]] == *points[order[j - 1]];
+            first[order[j]] = same ? first[order[j - 1]] : order[j];
+        }
+        for(uint32_t i = 0; i < points.size(); i++){
+            if(first[i] == i){
+                points[i]->id = vertices.size();
+                vertices.push_back(*points[i]);
+            }else{
+                points[i]->id = points[first[i]]->id;
+            }
+        }
+        return vertices;
+    }
 
-        // output the mesh format;
-        vector<vector<int>> vertex2tri_mapper(vertices.size());
-        for( int i = 0; i < triangles.size(); i ++ ){
-            const auto& tri  = triangles[i];
-            for(int j = 0; j < tri.vertices.size(); j++){
-                int v_id = tri.vertices[j];
-                if(v_id<0 || v_id > vertices.size()-1){
-                    cerr<<"Error: vertices index out of range"<<endl;
+    // A component is a polygon at even nesting depth together with the polygons directly inside it.
+    // The region between them never shares a triangle with any other component, so each component can be
+    // triangulated on its own.
+    struct Component
+    {
+        vector<CustomEdge> edges; // constraint edges, in global vertex ids
+    };
+
+    // Find the nesting depth and parent of every polygon by sweeping a vertical ray down the middle of the
+    // lattice column under one horizontal edge of each polygon, treating edge crossings as a stack.
+    // Returns false if the polygons are not rectilinear lattice polygons.
+    bool nest_polygons(const vector<CustomPoly>& polygons, vector<int>& parent, vector<int>& depth){
+        struct Crossing
+        {
+            int y;
+            int poly;
+        };
+        parent.assign(polygons.size(), -1);
+        depth.assign(polygons.size(), 0);
+        vector<pair<int, int>> probe(polygons.size());
+        vector<int> columns;
+        for(int i = 0; i < polygons.size(); i++){
+            const auto& vs = polygons[i].vertices;
+            bool found = false;
+            for(int j = 0; j < vs.size(); j++){
+                const auto& a = vs[j];
+                const auto& b = vs[(j + 1) % vs.size()];
+                if(a.x != (int)a.x || a.y != (int)a.y || (a.x != b.x && a.y != b.y)){
+                    return false;
+                }
+                if(!found && a.y == b.y && a.x != b.x){
+                    probe[i] = make_pair((int)min(a.x, b.x), (int)a.y);
+                    found = true;
+                }
+            }
+            if(!found){
+                return false;
+            }
+            columns.push_back(probe[i].first);
+        }
+        std::sort(columns.begin(), columns.end());
+        columns.erase(std::unique(columns.begin(), columns.end()), columns.end());
+
+        vector<vector<Crossing>> crossings(columns.size());
+        for(int i = 0; i < polygons.size(); i++){
+            const auto& vs = polygons[i].vertices;
+            for(int j = 0; j < vs.size(); j++){
+                const auto& a = vs[j];
+                const auto& b = vs[(j + 1) % vs.size()];
+                if(a.y != b.y){
+                    continue;
                 }
-                vertex2tri_mapper[v_id].push_back(i);
-            }
-        }
-
-        vector<vector<int>>vertices_index_list = vector<vector<int>>(vertex2tri_mapper.size());
-        for(int i = 0; i < vertex2tri_mapper.size(); i ++){
-            const auto & tri_list = vertex2tri_mapper[i];
-            vector<CustomPoint2D> sort_list;
-            for( const auto& tri : tri_list){
-                const auto& triangle = triangles[tri];
-                int index = 0;
-                bool found = false;
-                for(const auto& v_id :triangle.vertices){
-                    if(v_id == i){
-                        found =true;
-                        break;
+                int x1 = (int)min(a.x, b.x);
+                int x2 = (int)max(a.x, b.x);
+                for(auto c = std::lower_bound(columns.begin(), columns.end(), x1); c != columns.end() && *c < x2; c++){
+                    crossings[c - columns.begin()].push_back({(int)a.y, i});
+                }
+            }
+        }
+
+        vector<bool> inside(polygons.size(), false);
+        vector<int> stack;
+        for(int c = 0; c < columns.size(); c++){
+            auto& list = crossings[c];
+            std::sort(list.begin(), list.end(), [](const Crossing& a, const Crossing& b){ return a.y < b.y; });
+            stack.clear();
+            for(const auto& crossing : list){
+                if(inside[crossing.poly]){
+                    if(stack.back() != crossing.poly){
+                        return false;
                     }
-                    index ++;
+                    stack.pop_back();
+                }
+                if(probe[crossing.poly] == make_pair(columns[c], crossing.y)){
+                    parent[crossing.poly] = stack.empty() ? -1 : stack.back();
+                    depth[crossing.poly] = stack.size();
                 }
-                if(!found){
-                    cerr<< "Error: vertex not found"<<endl;
+                if(!inside[crossing.poly]){
+                    stack.push_back(crossing.poly);
                 }
+                inside[crossing.poly] = !inside[crossing.poly];
+            }
+            if(!stack.empty()){
+                return false;
+            }
+        }
+        return true;
+    }
 
-                int center_id = index;
-                index = index + 2;
-                index = index % 3;
-                // get represented vertices;
-                CustomPoint2D cur = vertices[triangle.vertices[index]];
-                cur.tri_id = tri;
-                cur.center_id = center_id;
-                sort_list.push_back(cur);
-            }
-            CustomPoint2D center = vertices[i];
-            std::sort(sort_list.begin(), sort_list.end(), [&center](const CustomPoint2D& p1, const CustomPoint2D& p2) {
-                return compare(p1, p2, center);
-            });
+    vector<Component> find_components(const vector<CustomPoly>& polygons){
+        TRACE_SCOPE("find_components");
+        vector<int> parent, depth;
+        vector<int> component_of(polygons.size(), 0);
+        vector<Component> components;
+        if(!nest_polygons(polygons, parent, depth)){
+            // fall back to a single triangulation covering everything
+            components.resize(1);
+        }else{
+            for(int i = 0; i < polygons.size(); i++){
+                if(depth[i] % 2 == 0){
+                    component_of[i] = components.size();
+                    components.emplace_back();
+                }
+            }
+            for(int i = 0; i < polygons.size(); i++){
+                if(depth[i] % 2 == 1){
+                    component_of[i] = component_of[parent[i]];
+                }
+            }
+        }
+        for(int i = 0; i < polygons.size(); i++){
+            const auto& poly = polygons[i];
+            auto& edges = components[component_of[i]].edges;
+            for(const auto& e : poly.edges){
+                edges.push_back(CustomEdge(poly.vertices[e.vertices.first].id, poly.vertices[e.vertices.second].id));
+            }
+        }
+        return components;
+    }
+
+    // which triangulation builds the component CDTs: the general library, the rectilinear builder (falling back
+    // to the library for input it does not handle), or both with their results compared
+    enum Triangulator {LIBRARY, RECTILINEAR, CHECK};
+    Triangulator triangulator = RECTILINEAR;
+
+    // number of vertical strips the library triangulates a component's vertices in, in parallel;
+    // 0 uses one per worker thread for components large enough to benefit
+    int strips = 0;
+
+    int strip_count(size_t num_vertices){
+        if(strips > 0){
+            return strips;
+        }
+        return worker_count(num_vertices / stripcdt::MIN_STRIP_POINTS);
+    }
+
+    // Do two triangulations of the same vertices have the same number of triangles and the same total area?
+    bool same_area(const CDT::TriangleVec& a, const CDT::TriangleVec& b, const vector<CustomPoint2D>& vertices){
+        auto area = [&vertices](const CDT::TriangleVec& triangles){
+            double twice = 0;
+            for(const auto& t : triangles){
+                const auto& p = vertices[t.vertices[0]];
+                const auto& q = vertices[t.vertices[1]];
+                const auto& r = vertices[t.vertices[2]];
+                twice += (q.x - p.x) * (r.y - p.y) - (q.y - p.y) * (r.x - p.x);
+            }
+            return twice;
+        };
+        return a.size() == b.size() && area(a) == area(b);
+    }
+
+    // What a worker triangulates components with. Every worker keeps its own from call to call and only clears
+    // it, so once the workers have triangulated maps as large as the next one, the library path allocates nothing.
+    struct Workspace {
+        CDT::Triangulation<double> cdt;
+        vector<int> global_to_local;
+        vector<CustomPoint2D> local_vertices;
+        vector<CDT::VertInd> local_to_global;
+        vector<CustomEdge> edges;
+        vector<CDT::V2d<double>> points;
+        vector<CDT::Edge> constraints;
+    };
+    // by worker index
+    vector<std::unique_ptr<Workspace>> workspaces;
+    // the triangles of the largest component, the second largest, ..., kept for the next call like the
+    // workspaces; never shrunk, so a map with fewer components does not throw away the buffers of the next one
+    vector<CDT::TriangleVec> component_triangles;
+
+    // Triangulate one component into triangles, with global vertex ids and component-local neighbour ids.
+    void triangulate_component(const Component& component, const vector<CustomPoint2D>& vertices, Workspace& work,
+                               CDT::TriangleVec& triangles){
+        TRACE_SCOPE("triangulate_component");
+        vector<int>& global_to_local = work.global_to_local;
+        vector<CustomPoint2D>& local_vertices = work.local_vertices;
+        vector<CDT::VertInd>& local_to_global = work.local_to_global;
+        vector<CustomEdge>& edges = work.edges;
+        local_vertices.clear();
+        local_to_global.clear();
+        edges.clear();
+        local_vertices.reserve(component.edges.size());
+        edges.reserve(component.edges.size());
+        auto local = [&](size_t v){
+            if(global_to_local[v] == -1){
+                global_to_local[v] = local_vertices.size();
+                local_vertices.push_back(vertices[v]);
+                local_to_global.push_back(v);
+            }
+            return (size_t)global_to_local[v];
+        };
+        for(const auto& e : component.edges){
+            size_t first = local(e.vertices.first);
+            edges.push_back(CustomEdge(first, local(e.vertices.second)));
+        }
+        for(auto v : local_to_global){
+            global_to_local[v] = -1;
+        }
 
-            vector<int> index_list ;
-            index_list.push_back(sort_list[0].tri_id);
-            if(sort_list.size() >= 2) {
-                const  auto&  prev_tri = triangles[sort_list[0].tri_id];
-                CustomPoint2D pre_v =  vertices[prev_tri.vertices[(sort_list[0].center_id + 2) % 3]];
-                for (int j = 1; j < sort_list.size(); j++) {
-                    const auto & curr_tri = triangles[sort_list[j].tri_id];
-                    const CustomPoint2D & curr_v = vertices[curr_tri.vertices[(sort_list[j].center_id + 1) % 3]];
-                    if (curr_v == pre_v) {
-                        // continue triangle;
-                        index_list.push_back(sort_list[j].tri_id);
-                    } else {
-                        index_list.push_back(-1);
-                        index_list.push_back(sort_list[j].tri_id);
+        triangles.clear();
+        vector<CDT::V2d<double>>& points = work.points;
+        bool built = false;
+        if(triangulator != LIBRARY){
+            vector<CDT::Edge>& constraints = work.constraints;
+            points.clear();
+            constraints.clear();
+            points.reserve(local_vertices.size());
+            constraints.reserve(edges.size());
+            for(const auto& p : local_vertices){
+                points.push_back(CDT::V2d<double>::make(p.x, p.y));
+            }
+            for(const auto& e : edges){
+                constraints.push_back(CDT::Edge(e.vertices.first, e.vertices.second));
+            }
+            built = rectcdt::triangulate(points, constraints, triangles);
+        }
+        if(!built || triangulator == CHECK){
+            CDT::Triangulation<double>& cdt = work.cdt;
+            cdt.clear();
+            // a triangulation of n vertices inside the super-triangle has 2n + 1 triangles
+            cdt.reserve(local_vertices.size(), 2 * local_vertices.size() + 1, edges.size());
+            const int strips = strip_count(local_vertices.size());
+            if(strips > 1){
+                points.clear();
+                points.reserve(local_vertices.size());
+                for(const auto& p : local_vertices){
+                    points.push_back(CDT::V2d<double>::make(p.x, p.y));
+                }
+                stripcdt::insertVertices(cdt, points, strips);
+            }else{
+                cdt.insertVertices(
+                        local_vertices.begin(),
+                        local_vertices.end(),
+                        [](const CustomPoint2D& p){ return p.x; },
+                        [](const CustomPoint2D& p){ return p.y; }
+                );
+            }
+            cdt.insertEdges(
+                    edges.begin(),
+                    edges.end(),
+                    [](const CustomEdge& e){ return e.vertices.first; },
+                    [](const CustomEdge& e){ return e.vertices.second; }
+            );
+            {
+                stats::Scope scope("cdt.erase_outer");
+                cdt.eraseOuterTrianglesAndHoles();
+            }
+            // any triangulation of the region has the library's triangle count and area, so that only checks
+            // the region; the exact test checks that the triangles are its constrained Delaunay triangulation
+            if(built && (!same_area(triangles, cdt.triangles, local_vertices) ||
+                         !rectcdt::is_constrained_delaunay(points, work.constraints, triangles))){
+                fail("Error: rectilinear triangulation disagrees with the library");
+            }
+            // copied rather than swapped: a swap would hand the largest component's buffer on to whichever
+            // component comes next, and every buffer would end up as large as the largest
+            triangles.assign(cdt.triangles.begin(), cdt.triangles.end());
+        }
+        for(auto& triangle : triangles){
+            for(auto& v : triangle.vertices){
+                v = local_to_global[v];
+            }
+        }
+    }
+
+    // Triangulate the components in parallel and concatenate them into one triangle list.
+    CDT::TriangleVec triangulate_components(const vector<Component>& components, const vector<CustomPoint2D>& vertices){
+        TRACE_SCOPE("triangulate_components");
+        // hand out the largest components first
+        vector<int> order(components.size());
+        for(int i = 0; i < order.size(); i++){
+            order[i] = i;
+        }
+        std::stable_sort(order.begin(), order.end(), [&components](int a, int b){
+            return components[a].edges.size() > components[b].edges.size();
+        });
+
+        vector<CDT::TriangleVec>& results = component_triangles;
+        if(results.size() < components.size()){
+            results.resize(components.size());
+        }
+        int workers = worker_count(components.size());
+        while(workspaces.size() < workers){
+            workspaces.emplace_back(new Workspace());
+        }
+        std::atomic<size_t> next(0);
+        std::exception_ptr error;
+        std::mutex error_mutex;
+        auto worker = [&](int index){
+            Workspace& work = *workspaces[index];
+            work.global_to_local.assign(vertices.size(), -1);
+            for(size_t job = next++; job < order.size(); job = next++){
+                try{
+                    triangulate_component(components[order[job]], vertices, work, results[job]);
+                }catch(...){
+                    std::lock_guard<std::mutex> lock(error_mutex);
+                    error = std::current_exception();
+                    next = order.size();
+                }
+            }
+        };
+        vector<std::thread> threads;
+        for(int i = 1; i < workers; i++){
+            threads.emplace_back(worker, i);
+        }
+        worker(0);
+        for(auto& t : threads){
+            t.join();
+        }
+        if(error){
+            std::rethrow_exception(error);
+        }
+
+        // concatenate in component order
+        vector<int> rank(components.size());
+        size_t total = 0;
+        for(int job = 0; job < order.size(); job++){
+            rank[order[job]] = job;
+            total += results[job].size();
+        }
+        CDT::TriangleVec triangles;
+        triangles.reserve(total);
+        for(int i = 0; i < components.size(); i++){
+            auto& r = results[rank[i]];
+            CDT::TriInd offset = triangles.size();
+            for(auto& triangle : r){
+                for(auto& n : triangle.neighbors){
+                    if(n != CDT::noNeighbor){
+                        n += offset;
                     }
-                    pre_v = vertices[curr_tri.vertices[(sort_list[j].center_id + 2) % 3]];
                 }
-                //check last tri with first_tri.
-                const  auto&  first_tri = triangles[sort_list[0].tri_id];
-                CustomPoint2D& first_v =  vertices[first_tri.vertices[(sort_list[0].center_id + 1) %3]];
-                if (first_v != pre_v) {
-                    index_list.push_back(-1);
+                triangles.push_back(triangle);
+            }
+            r.clear();
+        }
+        return triangles;
+    }
+
+    // Build the counter-clockwise list of triangles around every vertex by walking the triangle adjacency.
+    // Each list starts at the triangle whose far edge has the smallest polar angle, and -1 marks every gap
+    // between consecutive triangles (including the wrap from the last back to the first).
+    vector<vector<int>> build_vertex_fans(const CDT::TriangleVec& triangles, const vector<CustomPoint2D>& vertices){
+        TRACE_SCOPE("build_vertex_fans");
+        // a triangle starts a run around its corner k if nothing lies clockwise of it, i.e. across edge (k, k+1)
+        vector<CDT::TriInd> any_tri(vertices.size(), CDT::noNeighbor);
+        vector<size_t> run_begin(vertices.size() + 1, 0);
+        for(const auto& tri : triangles){
+            for(int k = 0; k < 3; k++){
+                if(tri.vertices[k] >= vertices.size()){
+                    cerr<<"Error: vertices index out of range"<<endl;
+                    exit(1);
+                }
+                if(tri.neighbors[k] == CDT::noNeighbor){
+                    run_begin[tri.vertices[k] + 1]++;
+                }
+            }
+        }
+        for(size_t v = 0; v < vertices.size(); v++){
+            run_begin[v + 1] += run_begin[v];
+        }
+        vector<CDT::TriInd> runs(run_begin.back());
+        vector<size_t> fill(run_begin.begin(), run_begin.end() - 1);
+        for(CDT::TriInd t = 0; t < triangles.size(); t++){
+            const auto& tri = triangles[t];
+            for(int k = 0; k < 3; k++){
+                any_tri[tri.vertices[k]] = t;
+                if(tri.neighbors[k] == CDT::noNeighbor){
+                    runs[fill[tri.vertices[k]]++] = t;
                 }
-            }else{
-                index_list.push_back(-1);
             }
-            vertices_index_list[i] = index_list;
         }
 
+        vector<vector<int>> fans(vertices.size());
+        auto build_fan = [&](size_t v, vector<CDT::TriInd>& order){
+            order.clear();
+            if(any_tri[v] == CDT::noNeighbor){
+                cerr<< "Error: vertex not found"<<endl;
+                return;
+            }
+            const CustomPoint2D& center = vertices[v];
+            auto corner = [&](CDT::TriInd t){
+                return (int)CDT::vertexInd(triangles[t].vertices, (CDT::VertInd)v);
+            };
+            auto end_vertex = [&](CDT::TriInd t){
+                return triangles[t].vertices[(corner(t) + 2) % 3];
+            };
+            auto start_vertex = [&](CDT::TriInd t){
+                return triangles[t].vertices[(corner(t) + 1) % 3];
+            };
+            auto key_less = [&](CDT::TriInd a, CDT::TriInd b){
+                const CustomPoint2D& pa = vertices[end_vertex(a)];
+                const CustomPoint2D& pb = vertices[end_vertex(b)];
+                return angle_less(pa.x - center.x, pa.y - center.y, pb.x - center.x, pb.y - center.y);
+            };
+            // walk counter-clockwise from a start until the boundary (or back to the start for a closed ring)
+            auto walk = [&](CDT::TriInd start){
+                CDT::TriInd t = start;
+                do{
+                    order.push_back(t);
+                    t = triangles[t].neighbors[(corner(t) + 2) % 3];
+                }while(t != CDT::noNeighbor && t != start);
+            };
+            if(run_begin[v] == run_begin[v + 1]){
+                walk(any_tri[v]);
+            }else{
+                vector<CDT::TriInd> starts(runs.begin() + run_begin[v], runs.begin() + run_begin[v + 1]);
+                std::sort(starts.begin(), starts.end(), key_less);
+                for(auto start : starts){
+                    walk(start);
+                }
+            }
+            size_t n = order.size();
+            size_t first = 0;
+            for(size_t j = 1; j < n; j++){
+                if(key_less(order[j], order[first])){
+                    first = j;
+                }
+            }
+            vector<int>& fan = fans[v];
+            fan.reserve(n + run_begin[v + 1] - run_begin[v] + 1);
+            for(size_t j = 0; j < n; j++){
+                CDT::TriInd t = order[(first + j) % n];
+                fan.push_back(t);
+                if(end_vertex(t) != start_vertex(order[(first + j + 1) % n])){
+                    fan.push_back(-1);
+                }
+            }
+        };
 
-        ofstream fout(output_file);
+        std::atomic<size_t> next(0);
+        const size_t chunk = 4096;
+        auto worker = [&](){
+            TRACE_SCOPE("build_vertex_fans worker");
+            vector<CDT::TriInd> order;
+            for(size_t begin = next.fetch_add(chunk); begin < vertices.size(); begin = next.fetch_add(chunk)){
+                size_t end = min(begin + chunk, vertices.size());
+                for(size_t v = begin; v < end; v++){
+                    build_fan(v, order);
+                }
+            }
+        };
+        int workers = worker_count(vertices.size() / chunk + 1);
+        vector<std::thread> threads;
+        for(int i = 1; i < workers; i++){
+            threads.emplace_back(worker);
+        }
+        worker();
+        for(auto& t : threads){
+            t.join();
+        }
+        return fans;
+    }
+
+    // vertices_index_list[v] lists the triangles around vertex v, as build_vertex_fans gives them
+    void print_mesh(ostream& fout, const vector<CustomPoint2D>& vertices, const CDT::TriangleVec& triangles,
+                    const vector<vector<int>>& vertices_index_list){
         fout << "mesh" << endl;
         fout << FORMAT_VERSION << endl;
         // Assume that all the vertices in the triangulation are interesting.
@@ -332,6 +773,87 @@ namespace poly2mesh {
         }
     }
 
+    void write_mesh(const vector<CustomPoint2D>& vertices, const CDT::TriangleVec& triangles, const std::string& output_file){
+        TRACE_SCOPE("write_mesh");
+        if(triangles.empty()){
+            cerr<<"Error: generating CDT failed "<<endl;
+        };
+
+        vector<vector<int>> vertices_index_list;
+        {
+            stats::Scope scope("cdt.fans");
+            vertices_index_list = build_vertex_fans(triangles, vertices);
+        }
+        stats::count("cdt.vertices", vertices.size());
+        stats::count("cdt.triangles", triangles.size());
+
+        stats::Scope scope("cdt.write");
+        ofstream fout(output_file);
+        print_mesh(fout, vertices, triangles, vertices_index_list);
+    }
+
+    // width is kept for the callers; the lattice extent used for welding is taken from the polygons themselves
+    void convertPoly2Mesh(const std::string input_file,const std::string output_file, int width){
+        TRACE_SCOPE("convertPoly2Mesh");
+
+        vector<CustomPoly>* polygons;
+        {
+            stats::Scope scope("cdt.read_poly");
+            ifstream fin(input_file);
+            polygons = read_polys(fin);
+        }
+        vector<CustomPoint2D> vertices;
+        {
+            stats::Scope scope("cdt.weld");
+            vertices = weld_vertices(*polygons);
+        }
+        vector<Component> components;
+        {
+            stats::Scope scope("cdt.components");
+            components = find_components(*polygons);
+        }
+        stats::count("cdt.components", components.size());
+        CDT::TriangleVec triangles;
+        {
+            stats::Scope scope("cdt.triangulate");
+            triangles = triangulate_components(components, vertices);
+        }
+        delete polygons;
+        write_mesh(vertices, triangles, output_file);
+    }
+
+    // Triangulate constraint segments fed directly from the grid, skipping the polygon map.
+    // Each segment is {first vertex, second vertex, region}; segments sharing a region are triangulated together.
+    void convertConstraints2Mesh(const vector<pair<int, int>>& points, const vector<std::array<int, 3>>& segments,
+                                 const std::string output_file){
+        TRACE_SCOPE("convertConstraints2Mesh");
+        vector<CustomPoint2D> vertices;
+        vertices.reserve(points.size());
+        for(const auto& p : points){
+            vertices.push_back(CustomPoint2D(p.first, p.second));
+            vertices.back().id = vertices.size() - 1;
+        }
+        vector<Component> components;
+        std::unordered_map<int, size_t> component_of;
+        for(const auto& s : segments){
+            auto it = component_of.find(s[2]);
+            if(it == component_of.end()){
+                it = component_of.insert(make_pair(s[2], components.size())).first;
+                components.emplace_back();
+            }
+            components[it->second].edges.push_back(CustomEdge(s[0], s[1]));
+        }
+
+        stats::count("cdt.components", components.size());
+        CDT::TriangleVec triangles;
+        {
+            stats::Scope scope("cdt.triangulate");
+            triangles = triangulate_components(components, vertices);
+        }
+        write_mesh(vertices, triangles, output_file);
+    }
+
+
 }
 
 #endif //STARTKIT_POLY2MESH_H
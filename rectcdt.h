@@ -0,0 +1,783 @@
+//
+// Constrained Delaunay triangulation specialised for rectilinear lattice polygons.
+//
+
+#ifndef STARTKIT_RECTCDT_H
+#define STARTKIT_RECTCDT_H
+/*
+The constraint edges grid2poly emits are all axis-aligned between integer
+lattice points, and the region to triangulate is everything inside an odd
+number of them. That lets us skip the incremental Delaunay insertion and the
+constraint-edge recovery of the general library:
+- edges are split where another vertex lies on them, chained into closed
+  loops and oriented so the region is on their left, using one exact parity
+  probe per loop;
+- a plane sweep (top to bottom, left to right on ties) splits the region into
+  y-monotone pieces with diagonals, as in de Berg et al., "Computational
+  Geometry", chapter 3. Axis-aligned edges make the sweep status a plain
+  ordered map of vertical edges keyed on x. Maps of long horizontal
+  corridors are swept along x instead (see row_ties);
+- each monotone piece is triangulated with the linear stack algorithm;
+- Lawson edge flips with the exact in-circle predicate turn the result into a
+  constrained Delaunay triangulation.
+Vertices where two loops touch diagonally (pinch points) are visited once per
+region wedge. Anything the builder cannot handle is reported by returning
+false, and the caller falls back to the general triangulation.
+*/
+#include "counters.h"
+#include "CDT.h"
+#include "trace.h"
+#include <vector>
+#include <map>
+#include <array>
+#include <algorithm>
+#include <utility>
+#include <cmath>
+#include <cstdint>
+
+namespace rectcdt {
+    typedef long long coord;
+
+    // coordinates must stay small enough for exact 64-bit cross products
+    const double MAX_COORD = 1 << 29;
+
+    inline coord cross(coord ax, coord ay, coord bx, coord by) {
+        return ax * by - ay * bx;
+    }
+
+    // Is direction a before direction b when turning counter-clockwise from direction r?
+    inline bool ccw_before(coord rx, coord ry, coord ax, coord ay, coord bx, coord by) {
+        const int half_a = (cross(rx, ry, ax, ay) > 0 || (cross(rx, ry, ax, ay) == 0 && rx * ax + ry * ay > 0)) ? 0 : 1;
+        const int half_b = (cross(rx, ry, bx, by) > 0 || (cross(rx, ry, bx, by) == 0 && rx * bx + ry * by > 0)) ? 0 : 1;
+        if (half_a != half_b) {
+            return half_a < half_b;
+        }
+        return cross(ax, ay, bx, by) > 0;
+    }
+
+    // The sweep below visits the vertices of a row one after the other, so a piece with a long row on one side
+    // starts as a fan from the other side, and undoing a fan of k triangles takes the flips about k^2 / 2
+    // steps. Returns the sum over rows of the squared number of vertices in them, to sweep across the axis
+    // with the shorter rows.
+    inline long long row_ties(std::vector<coord> rows) {
+        std::sort(rows.begin(), rows.end());
+        long long ties = 0;
+        for (size_t i = 0, j = 0; i < rows.size(); i = j) {
+            while (j < rows.size() && rows[j] == rows[i]) {
+                j++;
+            }
+            ties += (long long) (j - i) * (j - i);
+        }
+        return ties;
+    }
+
+    // One visit of the boundary to a vertex: the boundary segment coming in, the one going out, and the
+    // nodes before and after it along the boundary. Pinch points get one node per region wedge.
+    struct Node {
+        int vertex;
+        int in, out;
+        int prev, next;
+    };
+
+    enum NodeType {
+        START, END, SPLIT, MERGE, REGULAR
+    };
+
+    // Triangulate the region inside an odd number of the given loops of axis-aligned lattice edges.
+    // Triangles use the library's conventions: counter-clockwise vertices, neighbors[i] across the edge
+    // (vertices[i], vertices[i + 1]). Returns false if the input is not something this builder handles.
+    bool triangulate(const std::vector<CDT::V2d<double> > &points, const std::vector<CDT::Edge> &edges,
+                     CDT::TriangleVec &triangles) {
+        TRACE_SCOPE("rectcdt::triangulate");
+        triangles.clear();
+        const int n = points.size();
+        std::vector<coord> X(n), Y(n);
+        for (int i = 0; i < n; i++) {
+            const double x = points[i].x, y = points[i].y;
+            if (x != std::floor(x) || y != std::floor(y) || std::fabs(x) >= MAX_COORD || std::fabs(y) >= MAX_COORD) {
+                return false;
+            }
+            X[i] = (coord) x;
+            Y[i] = (coord) y;
+        }
+        if (row_ties(Y) > row_ties(X)) {
+            // sweep the lattice turned a quarter turn, which keeps orientations and in-circle tests
+            for (int i = 0; i < n; i++) {
+                const coord x = X[i];
+                X[i] = -Y[i];
+                Y[i] = x;
+            }
+        }
+
+        // Split the edges at every vertex lying on them.
+        std::vector<int> by_row(n), by_column(n);
+        for (int i = 0; i < n; i++) {
+            by_row[i] = by_column[i] = i;
+        }
+        std::sort(by_row.begin(), by_row.end(), [&](int a, int b) {
+            return Y[a] < Y[b] || (Y[a] == Y[b] && X[a] < X[b]);
+        });
+        std::sort(by_column.begin(), by_column.end(), [&](int a, int b) {
+            return X[a] < X[b] || (X[a] == X[b] && Y[a] < Y[b]);
+        });
+        for (int i = 1; i < n; i++) {
+            if (X[by_row[i]] == X[by_row[i - 1]] && Y[by_row[i]] == Y[by_row[i - 1]]) {
+                return false;
+            }
+        }
+        std::vector<std::pair<int, int> > segments;
+        segments.reserve(edges.size());
+        for (const auto &e : edges) {
+            int a = e.v1(), b = e.v2();
+            if (Y[a] == Y[b] && X[a] != X[b]) {
+                if (X[a] > X[b]) {
+                    std::swap(a, b);
+                }
+                auto it = std::upper_bound(by_row.begin(), by_row.end(), a, [&](int p, int q) {
+                    return Y[p] < Y[q] || (Y[p] == Y[q] && X[p] < X[q]);
+                });
+                for (; it != by_row.end() && Y[*it] == Y[a] && X[*it] < X[b]; ++it) {
+                    segments.push_back({a, *it});
+                    a = *it;
+                }
+            } else if (X[a] == X[b] && Y[a] != Y[b]) {
+                if (Y[a] > Y[b]) {
+                    std::swap(a, b);
+                }
+                auto it = std::upper_bound(by_column.begin(), by_column.end(), a, [&](int p, int q) {
+                    return X[p] < X[q] || (X[p] == X[q] && Y[p] < Y[q]);
+                });
+                for (; it != by_column.end() && X[*it] == X[a] && Y[*it] < Y[b]; ++it) {
+                    segments.push_back({a, *it});
+                    a = *it;
+                }
+            } else {
+                return false;
+            }
+            segments.push_back({a, b});
+        }
+        const int m = segments.size();
+        auto horizontal = [&](int s) { return Y[segments[s].first] == Y[segments[s].second]; };
+        auto other_end = [&](int s, int v) { return segments[s].first == v ? segments[s].second : segments[s].first; };
+
+        std::vector<int> degree(n, 0);
+        std::vector<std::array<int, 4> > incident(n);
+        for (int s = 0; s < m; s++) {
+            for (int v : {segments[s].first, segments[s].second}) {
+                if (degree[v] == 4) {
+                    return false;
+                }
+                incident[v][degree[v]++] = s;
+            }
+        }
+        for (int v = 0; v < n; v++) {
+            if (degree[v] != 2 && degree[v] != 4) {
+                return false;
+            }
+        }
+
+        // Chain the segments into closed loops. At a pinch point a loop always turns, never goes straight on,
+        // so every loop can be oriented consistently.
+        std::vector<int> chain_of(m, -1);
+        std::vector<char> forward(m, 1);
+        std::vector<int> chain_probe; // a horizontal segment of every chain
+        for (int s0 = 0; s0 < m; s0++) {
+            if (chain_of[s0] != -1) {
+                continue;
+            }
+            const int chain = chain_probe.size();
+            chain_probe.push_back(-1);
+            int t = s0, v = segments[s0].second;
+            chain_of[s0] = chain;
+            while (true) {
+                if (chain_probe[chain] == -1 && horizontal(t)) {
+                    chain_probe[chain] = t;
+                }
+                int next = -1;
+                bool closed = false;
+                for (int k = 0; k < degree[v]; k++) {
+                    const int s = incident[v][k];
+                    if (s == t || (degree[v] == 4 && horizontal(s) == horizontal(t))) {
+                        continue;
+                    }
+                    if (s == s0 && v == segments[s0].first) {
+                        closed = true;
+                    } else if (chain_of[s] == -1 && next == -1) {
+                        next = s;
+                    }
+                }
+                if (closed) {
+                    break;
+                }
+                if (next == -1) {
+                    return false;
+                }
+                chain_of[next] = chain;
+                forward[next] = segments[next].first == v;
+                v = other_end(next, v);
+                t = next;
+            }
+            if (chain_probe[chain] == -1) {
+                return false;
+            }
+        }
+
+        // The region lies just below a horizontal segment if an odd number of horizontal segments cover the
+        // segment's first column at or above it.
+        std::vector<coord> columns;
+        for (int s : chain_probe) {
+            columns.push_back(std::min(X[segments[s].first], X[segments[s].second]));
+        }
+        std::sort(columns.begin(), columns.end());
+        columns.erase(std::unique(columns.begin(), columns.end()), columns.end());
+        std::vector<std::vector<coord> > column_rows(columns.size());
+        for (int s = 0; s < m; s++) {
+            if (!horizontal(s)) {
+                continue;
+            }
+            const coord x1 = std::min(X[segments[s].first], X[segments[s].second]);
+            const coord x2 = std::max(X[segments[s].first], X[segments[s].second]);
+            for (auto c = std::lower_bound(columns.begin(), columns.end(), x1); c != columns.end() && *c < x2; ++c) {
+                column_rows[c - columns.begin()].push_back(Y[segments[s].first]);
+            }
+        }
+        for (auto &rows : column_rows) {
+            std::sort(rows.begin(), rows.end());
+        }
+        std::vector<char> flip_chain(chain_probe.size(), 0);
+        for (int chain = 0; chain < chain_probe.size(); chain++) {
+            const int s = chain_probe[chain];
+            const int from = forward[s] ? segments[s].first : segments[s].second;
+            const int to = forward[s] ? segments[s].second : segments[s].first;
+            const coord x1 = std::min(X[from], X[to]);
+            const auto &rows = column_rows[std::lower_bound(columns.begin(), columns.end(), x1) - columns.begin()];
+            const bool region_below = (std::upper_bound(rows.begin(), rows.end(), Y[from]) - rows.begin()) % 2 == 1;
+            // the region must be on the left, which for a segment running towards +x is the +y side
+            flip_chain[chain] = region_below != (X[to] > X[from]);
+        }
+        std::vector<int> seg_from(m), seg_to(m);
+        for (int s = 0; s < m; s++) {
+            const bool f = forward[s] != flip_chain[chain_of[s]];
+            seg_from[s] = f ? segments[s].first : segments[s].second;
+            seg_to[s] = f ? segments[s].second : segments[s].first;
+        }
+
+        // Build the boundary nodes; at a pinch point each incoming segment pairs with the outgoing one it turns
+        // left into.
+        std::vector<Node> nodes;
+        nodes.reserve(m);
+        std::vector<int> node_of_in(m, -1), node_of_out(m, -1);
+        for (int v = 0; v < n; v++) {
+            int ins[2], outs[2], num_in = 0, num_out = 0;
+            for (int k = 0; k < degree[v]; k++) {
+                const int s = incident[v][k];
+                if (seg_to[s] == v) {
+                    if (num_in == 2) return false;
+                    ins[num_in++] = s;
+                } else {
+                    if (num_out == 2) return false;
+                    outs[num_out++] = s;
+                }
+            }
+            if (num_in != num_out) {
+                return false;
+            }
+            for (int k = 0; k < num_in; k++) {
+                int out = outs[0];
+                if (num_out == 2) {
+                    const int in = ins[k];
+                    out = -1;
+                    for (int j = 0; j < 2; j++) {
+                        const int o = outs[j];
+                        if (cross(X[v] - X[seg_from[in]], Y[v] - Y[seg_from[in]],
+                                  X[seg_to[o]] - X[v], Y[seg_to[o]] - Y[v]) > 0) {
+                            out = o;
+                        }
+                    }
+                    if (out == -1 || node_of_out[out] != -1) {
+                        return false;
+                    }
+                }
+                node_of_in[ins[k]] = node_of_out[out] = nodes.size();
+                nodes.push_back({v, ins[k], out, -1, -1});
+            }
+        }
+        for (auto &node : nodes) {
+            node.next = node_of_in[node.out];
+            node.prev = node_of_out[node.in];
+        }
+        const int num_nodes = nodes.size();
+        auto NX = [&](int node) { return X[nodes[node].vertex]; };
+        auto NY = [&](int node) { return Y[nodes[node].vertex]; };
+
+        // Sweep order: larger y first, then smaller x. Of the two nodes of a pinch point, the one with a
+        // segment towards +y comes first.
+        std::vector<int> order(num_nodes), rank(num_nodes);
+        for (int i = 0; i < num_nodes; i++) {
+            order[i] = i;
+        }
+        auto goes_up = [&](int node) {
+            return Y[seg_from[nodes[node].in]] > NY(node) || Y[seg_to[nodes[node].out]] > NY(node);
+        };
+        std::sort(order.begin(), order.end(), [&](int a, int b) {
+            if (NY(a) != NY(b)) return NY(a) > NY(b);
+            if (NX(a) != NX(b)) return NX(a) < NX(b);
+            return goes_up(a) && !goes_up(b);
+        });
+        for (int i = 0; i < num_nodes; i++) {
+            rank[order[i]] = i;
+        }
+
+        std::vector<NodeType> type(num_nodes);
+        for (int i = 0; i < num_nodes; i++) {
+            const int p = nodes[i].prev, q = nodes[i].next;
+            const bool convex = cross(NX(i) - NX(p), NY(i) - NY(p), NX(q) - NX(i), NY(q) - NY(i)) > 0;
+            if (rank[p] > rank[i] && rank[q] > rank[i]) {
+                type[i] = convex ? START : SPLIT;
+            } else if (rank[p] < rank[i] && rank[q] < rank[i]) {
+                type[i] = convex ? END : MERGE;
+            } else {
+                type[i] = REGULAR;
+            }
+        }
+
+        // Split the region into y-monotone pieces. The status holds the boundary segments with the region
+        // on their right; only vertical ones can ever be the segment directly left of a node.
+        std::map<coord, int> status;
+        std::vector<int> helper(m, -1);
+        std::vector<std::pair<int, int> > diagonals;
+        bool ok = true;
+        auto insert_segment = [&](int s, int node) {
+            helper[s] = node;
+            if (!horizontal(s) && !status.emplace(X[seg_from[s]], s).second) {
+                ok = false;
+            }
+        };
+        auto remove_segment = [&](int s) {
+            if (horizontal(s)) {
+                return;
+            }
+            auto it = status.find(X[seg_from[s]]);
+            if (it == status.end() || it->second != s) {
+                ok = false;
+                return;
+            }
+            status.erase(it);
+        };
+        auto left_of = [&](int node) {
+            auto it = status.lower_bound(NX(node));
+            if (it == status.begin()) {
+                ok = false;
+                return -1;
+            }
+            return (--it)->second;
+        };
+        auto is_merge = [&](int node) { return node != -1 && type[node] == MERGE; };
+        for (int k = 0; k < num_nodes && ok; k++) {
+            const int i = order[k];
+            const int in = nodes[i].in, out = nodes[i].out;
+            switch (type[i]) {
+                case START:
+                    insert_segment(out, i);
+                    break;
+                case END:
+                    if (is_merge(helper[in])) diagonals.push_back({i, helper[in]});
+                    remove_segment(in);
+                    break;
+                case SPLIT: {
+                    const int j = left_of(i);
+                    if (j == -1) break;
+                    diagonals.push_back({i, helper[j]});
+                    helper[j] = i;
+                    insert_segment(out, i);
+                    break;
+                }
+                case MERGE: {
+                    if (is_merge(helper[in])) diagonals.push_back({i, helper[in]});
+                    remove_segment(in);
+                    const int j = left_of(i);
+                    if (j == -1) break;
+                    if (is_merge(helper[j])) diagonals.push_back({i, helper[j]});
+                    helper[j] = i;
+                    break;
+                }
+                case REGULAR:
+                    if (rank[nodes[i].prev] < rank[i]) {
+                        // the boundary runs downwards here, so the region is on its right
+                        if (is_merge(helper[in])) diagonals.push_back({i, helper[in]});
+                        remove_segment(in);
+                        insert_segment(out, i);
+                    } else {
+                        const int j = left_of(i);
+                        if (j == -1) break;
+                        if (is_merge(helper[j])) diagonals.push_back({i, helper[j]});
+                        helper[j] = i;
+                    }
+                    break;
+            }
+        }
+        if (!ok || !status.empty()) {
+            return false;
+        }
+
+        // Walk the faces cut out by the diagonals. Half-edges leaving a node are ordered counter-clockwise from
+        // its boundary segment, and a face continues with the half-edge clockwise next to the one it came in on.
+        const int num_half = num_nodes + 2 * diagonals.size();
+        std::vector<int> he_from(num_half), he_to(num_half);
+        for (int i = 0; i < num_nodes; i++) {
+            he_from[i] = i;
+            he_to[i] = nodes[i].next;
+        }
+        for (int d = 0; d < diagonals.size(); d++) {
+            he_from[num_nodes + 2 * d] = he_to[num_nodes + 2 * d + 1] = diagonals[d].first;
+            he_to[num_nodes + 2 * d] = he_from[num_nodes + 2 * d + 1] = diagonals[d].second;
+        }
+        std::vector<std::vector<int> > leaving(num_nodes);
+        for (int i = 0; i < num_nodes; i++) {
+            leaving[i].push_back(i);
+        }
+        for (int h = num_nodes; h < num_half; h++) {
+            leaving[he_from[h]].push_back(h);
+        }
+        std::vector<int> position(num_half);
+        for (int i = 0; i < num_nodes; i++) {
+            auto &hs = leaving[i];
+            if (hs.size() > 2) {
+                const coord rx = NX(nodes[i].next) - NX(i), ry = NY(nodes[i].next) - NY(i);
+                std::sort(hs.begin() + 1, hs.end(), [&](int a, int b) {
+                    return ccw_before(rx, ry, NX(he_to[a]) - NX(i), NY(he_to[a]) - NY(i),
+                                      NX(he_to[b]) - NX(i), NY(he_to[b]) - NY(i));
+                });
+            }
+            for (int k = 0; k < hs.size(); k++) {
+                position[hs[k]] = k;
+            }
+        }
+        std::vector<int> twin(num_half, -1);
+        for (int d = 0; d < diagonals.size(); d++) {
+            twin[num_nodes + 2 * d] = num_nodes + 2 * d + 1;
+            twin[num_nodes + 2 * d + 1] = num_nodes + 2 * d;
+        }
+        auto face_next = [&](int h) {
+            const auto &hs = leaving[he_to[h]];
+            if (h < num_nodes) {
+                return hs.back();
+            }
+            const int k = position[twin[h]];
+            return k == 0 ? -1 : hs[k - 1];
+        };
+
+        triangles.reserve(2 * n);
+        std::vector<char> walked(num_half, 0);
+        std::vector<int> face, sorted, stack;
+        std::vector<char> left_chain(num_nodes, 0);
+        auto emit = [&](int a, int b, int c) {
+            int va = nodes[a].vertex, vb = nodes[b].vertex, vc = nodes[c].vertex;
+            const coord o = cross(X[vb] - X[va], Y[vb] - Y[va], X[vc] - X[va], Y[vc] - Y[va]);
+            if (o == 0) {
+                ok = false;
+                return;
+            }
+            if (o < 0) {
+                std::swap(vb, vc);
+            }
+            CDT::Triangle t;
+            t.vertices = {(CDT::VertInd) va, (CDT::VertInd) vb, (CDT::VertInd) vc};
+            t.neighbors = {CDT::noNeighbor, CDT::noNeighbor, CDT::noNeighbor};
+            triangles.push_back(t);
+        };
+        for (int h0 = 0; h0 < num_half && ok; h0++) {
+            if (walked[h0]) {
+                continue;
+            }
+            face.clear();
+            int h = h0;
+            do {
+                if (h == -1 || walked[h] || face.size() > num_nodes) {
+                    return false;
+                }
+                walked[h] = 1;
+                face.push_back(he_from[h]);
+                h = face_next(h);
+            } while (h != h0);
+            const int k = face.size();
+            if (k < 3) {
+                return false;
+            }
+
+            // Triangulate the monotone face: the left chain runs down from the top node in face order.
+            int top = 0, bottom = 0;
+            for (int j = 1; j < k; j++) {
+                if (rank[face[j]] < rank[face[top]]) top = j;
+                if (rank[face[j]] > rank[face[bottom]]) bottom = j;
+            }
+            sorted.clear();
+            for (int j = (top + 1) % k; j != bottom; j = (j + 1) % k) {
+                left_chain[face[j]] = 1;
+            }
+            for (int j = (bottom + 1) % k; j != top; j = (j + 1) % k) {
+                left_chain[face[j]] = 0;
+            }
+            left_chain[face[top]] = left_chain[face[bottom]] = 0;
+            // merge the two chains, checking that the face really is monotone
+            int l = (top + 1) % k, r = (top + k - 1) % k;
+            sorted.push_back(face[top]);
+            while (l != bottom || r != bottom) {
+                if (r == bottom || (l != bottom && rank[face[l]] < rank[face[r]])) {
+                    if (rank[face[l]] < rank[sorted.back()]) return false;
+                    sorted.push_back(face[l]);
+                    l = (l + 1) % k;
+                } else {
+                    if (rank[face[r]] < rank[sorted.back()]) return false;
+                    sorted.push_back(face[r]);
+                    r = (r + k - 1) % k;
+                }
+            }
+            sorted.push_back(face[bottom]);
+
+            stack.clear();
+            stack.push_back(sorted[0]);
+            stack.push_back(sorted[1]);
+            for (int j = 2; j + 1 < k && ok; j++) {
+                const int u = sorted[j];
+                if (left_chain[u] != left_chain[stack.back()]) {
+                    for (int s = stack.size() - 1; s > 0; s--) {
+                        emit(u, stack[s], stack[s - 1]);
+                    }
+                    const int last = stack.back();
+                    stack.clear();
+                    stack.push_back(last);
+                    stack.push_back(u);
+                } else {
+                    int last = stack.back();
+                    stack.pop_back();
+                    while (!stack.empty()) {
+                        const int w = stack.back();
+                        const coord o = cross(NX(last) - NX(w), NY(last) - NY(w), NX(u) - NX(last), NY(u) - NY(last));
+                        // the chain bends away from the region, so the diagonal would leave the face
+                        if (left_chain[u] ? o <= 0 : o >= 0) {
+                            break;
+                        }
+                        emit(u, last, w);
+                        last = w;
+                        stack.pop_back();
+                    }
+                    stack.push_back(last);
+                    stack.push_back(u);
+                }
+            }
+            for (int s = stack.size() - 1; s > 0 && ok; s--) {
+                emit(sorted[k - 1], stack[s], stack[s - 1]);
+            }
+        }
+        if (!ok) {
+            return false;
+        }
+
+        // Link the triangles across their shared edges.
+        std::vector<std::pair<uint64_t, uint32_t> > sides;
+        sides.reserve(3 * triangles.size());
+        for (uint32_t t = 0; t < triangles.size(); t++) {
+            for (int i = 0; i < 3; i++) {
+                const uint64_t a = triangles[t].vertices[i], b = triangles[t].vertices[(i + 1) % 3];
+                sides.push_back({std::min(a, b) << 32 | std::max(a, b), 3 * t + i});
+            }
+        }
+        std::sort(sides.begin(), sides.end());
+        for (size_t j = 0; j < sides.size();) {
+            size_t e = j + 1;
+            while (e < sides.size() && sides[e].first == sides[j].first) {
+                e++;
+            }
+            if (e - j > 2) {
+                return false;
+            }
+            if (e - j == 2) {
+                const uint32_t a = sides[j].second, b = sides[j + 1].second;
+                triangles[a / 3].neighbors[a % 3] = b / 3;
+                triangles[b / 3].neighbors[b % 3] = a / 3;
+            }
+            j = e;
+        }
+
+        // Lawson flips until every unconstrained edge is locally Delaunay. Boundary segments have no
+        // neighbour across them, so every shared edge may be flipped.
+        struct Side {
+            CDT::TriInd tri;
+            CDT::VertInd a, b;
+        };
+        std::vector<Side> work;
+        for (CDT::TriInd t = 0; t < triangles.size(); t++) {
+            for (int i = 0; i < 3; i++) {
+                if (triangles[t].neighbors[i] != CDT::noNeighbor && triangles[t].neighbors[i] > t) {
+                    work.push_back({t, triangles[t].vertices[i], triangles[t].vertices[(i + 1) % 3]});
+                }
+            }
+        }
+        auto side_index = [](const CDT::Triangle &tri, CDT::VertInd a, CDT::VertInd b) {
+            for (int i = 0; i < 3; i++) {
+                if (tri.vertices[i] == a && tri.vertices[(i + 1) % 3] == b) {
+                    return i;
+                }
+            }
+            return -1;
+        };
+        auto relink = [&](CDT::TriInd t, CDT::TriInd from, CDT::TriInd to) {
+            if (t == CDT::noNeighbor) {
+                return;
+            }
+            for (auto &nb : triangles[t].neighbors) {
+                if (nb == from) {
+                    nb = to;
+                    return;
+                }
+            }
+        };
+        while (!work.empty()) {
+            const Side side = work.back();
+            work.pop_back();
+            const CDT::TriInd t = side.tri;
+            const int i = side_index(triangles[t], side.a, side.b);
+            if (i == -1) {
+                continue;
+            }
+            const CDT::TriInd u = triangles[t].neighbors[i];
+            if (u == CDT::noNeighbor) {
+                continue;
+            }
+            const CDT::VertInd a = side.a, b = side.b, c = triangles[t].vertices[(i + 2) % 3];
+            const int j = side_index(triangles[u], b, a);
+            if (j == -1) {
+                return false;
+            }
+            const CDT::VertInd d = triangles[u].vertices[(j + 2) % 3];
+            if (!CDT::isInCircumcircle(points[d], points[a], points[b], points[c])) {
+                continue;
+            }
+            COUNT(cdt_flips, 1);
+            const CDT::TriInd n_bc = triangles[t].neighbors[(i + 1) % 3];
+            const CDT::TriInd n_ca = triangles[t].neighbors[(i + 2) % 3];
+            const CDT::TriInd n_ad = triangles[u].neighbors[(j + 1) % 3];
+            const CDT::TriInd n_db = triangles[u].neighbors[(j + 2) % 3];
+            triangles[t].vertices = {a, d, c};
+            triangles[t].neighbors = {n_ad, u, n_ca};
+            triangles[u].vertices = {d, b, c};
+            triangles[u].neighbors = {n_db, n_bc, t};
+            relink(n_ad, u, t);
+            relink(n_bc, t, u);
+            work.push_back({t, a, d});
+            work.push_back({t, c, a});
+            work.push_back({u, d, b});
+            work.push_back({u, b, c});
+        }
+        return true;
+    }
+
+    __extension__ typedef __int128 wide;
+
+    // Is lattice point d strictly inside the circle through the counter-clockwise lattice points a, b and c?
+    // Exact: with coordinates below MAX_COORD every term fits in 124 bits.
+    inline bool in_circle(coord ax, coord ay, coord bx, coord by, coord cx, coord cy, coord dx, coord dy) {
+        const wide adx = ax - dx, ady = ay - dy, bdx = bx - dx, bdy = by - dy, cdx = cx - dx, cdy = cy - dy;
+        const wide det = (adx * adx + ady * ady) * (bdx * cdy - cdx * bdy) +
+                         (bdx * bdx + bdy * bdy) * (cdx * ady - adx * cdy) +
+                         (cdx * cdx + cdy * cdy) * (adx * bdy - bdx * ady);
+        return det > 0;
+    }
+
+    // Is triangles a constrained Delaunay triangulation for the given axis-aligned lattice edges? Checks
+    // exactly that every triangle is counter-clockwise and its neighbours point back at it, that every edge,
+    // split at the vertices lying on it, is made of triangle sides, that every side without a neighbour
+    // belongs to an edge, and that across every other side the far vertex is not inside the circumcircle.
+    // Which region the triangles cover is left to the caller.
+    bool is_constrained_delaunay(const std::vector<CDT::V2d<double> > &points, const std::vector<CDT::Edge> &edges,
+                                 const CDT::TriangleVec &triangles) {
+        const int n = points.size();
+        std::vector<coord> X(n), Y(n);
+        for (int i = 0; i < n; i++) {
+            if (points[i].x != std::floor(points[i].x) || points[i].y != std::floor(points[i].y) ||
+                std::fabs(points[i].x) >= MAX_COORD || std::fabs(points[i].y) >= MAX_COORD) {
+                return false;
+            }
+            X[i] = (coord) points[i].x;
+            Y[i] = (coord) points[i].y;
+        }
+        auto key = [](uint64_t a, uint64_t b) { return std::min(a, b) << 32 | std::max(a, b); };
+
+        // the pieces of the edges between consecutive vertices on them
+        std::vector<int> by_row(n), by_column(n);
+        for (int i = 0; i < n; i++) {
+            by_row[i] = by_column[i] = i;
+        }
+        auto row_less = [&](int a, int b) { return Y[a] < Y[b] || (Y[a] == Y[b] && X[a] < X[b]); };
+        auto column_less = [&](int a, int b) { return X[a] < X[b] || (X[a] == X[b] && Y[a] < Y[b]); };
+        std::sort(by_row.begin(), by_row.end(), row_less);
+        std::sort(by_column.begin(), by_column.end(), column_less);
+        std::vector<uint64_t> pieces;
+        for (const auto &e : edges) {
+            int a = e.v1(), b = e.v2();
+            const bool horizontal = Y[a] == Y[b];
+            if (horizontal ? X[a] == X[b] : X[a] != X[b]) {
+                return false;
+            }
+            if (horizontal ? X[a] > X[b] : Y[a] > Y[b]) {
+                std::swap(a, b);
+            }
+            const std::vector<int> &line = horizontal ? by_row : by_column;
+            auto it = horizontal ? std::upper_bound(line.begin(), line.end(), a, row_less)
+                                 : std::upper_bound(line.begin(), line.end(), a, column_less);
+            for (; it != line.end() && *it != b; ++it) {
+                pieces.push_back(key(a, *it));
+                a = *it;
+            }
+            pieces.push_back(key(a, b));
+        }
+        std::sort(pieces.begin(), pieces.end());
+        auto is_piece = [&](uint64_t k) { return std::binary_search(pieces.begin(), pieces.end(), k); };
+
+        std::vector<uint64_t> sides;
+        sides.reserve(3 * triangles.size());
+        for (CDT::TriInd t = 0; t < triangles.size(); t++) {
+            const auto &tri = triangles[t];
+            const CDT::VertInd a = tri.vertices[0], b = tri.vertices[1], c = tri.vertices[2];
+            if (a >= (CDT::VertInd) n || b >= (CDT::VertInd) n || c >= (CDT::VertInd) n ||
+                cross(X[b] - X[a], Y[b] - Y[a], X[c] - X[a], Y[c] - Y[a]) <= 0) {
+                return false;
+            }
+            for (int i = 0; i < 3; i++) {
+                const CDT::VertInd p = tri.vertices[i], q = tri.vertices[(i + 1) % 3], r = tri.vertices[(i + 2) % 3];
+                sides.push_back(key(p, q));
+                const CDT::TriInd u = tri.neighbors[i];
+                if (u == CDT::noNeighbor) {
+                    if (!is_piece(key(p, q))) {
+                        return false;
+                    }
+                    continue;
+                }
+                if (u >= triangles.size()) {
+                    return false;
+                }
+                int j = 0;
+                while (j < 3 && !(triangles[u].vertices[j] == q && triangles[u].vertices[(j + 1) % 3] == p)) {
+                    j++;
+                }
+                if (j == 3 || triangles[u].neighbors[j] != t) {
+                    return false;
+                }
+                const CDT::VertInd d = triangles[u].vertices[(j + 2) % 3];
+                if (!is_piece(key(p, q)) && in_circle(X[p], Y[p], X[q], Y[q], X[r], Y[r], X[d], Y[d])) {
+                    return false;
+                }
+            }
+        }
+        std::sort(sides.begin(), sides.end());
+        for (uint64_t piece : pieces) {
+            if (!std::binary_search(sides.begin(), sides.end(), piece)) {
+                return false;
+            }
+        }
+        return true;
+    }
+}
+
+#endif //STARTKIT_RECTCDT_H
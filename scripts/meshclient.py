@@ -0,0 +1,105 @@
+#!/usr/bin/env python3
+#
+# Client for the conversion daemon ("run -serve SOCKET", protocol in server.h). Converts a .map file, or
+# sends its cells inline with --send-grid, and prints where the meshes went or saves the meshes sent back.
+#
+#   ./run -serve /tmp/startkit.sock --workers=4 --threads=2 &
+#   scripts/meshclient.py /tmp/startkit.sock mcdt data/AcrosstheCape.map
+#   scripts/meshclient.py /tmp/startkit.sock cdt data/AcrosstheCape.map --send-grid --save=out --option=--direct
+#
+
+import argparse
+import socket
+import sys
+import time
+
+
+class Client:
+    def __init__(self, path):
+        self.sock = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+        self.sock.connect(path)
+        self.file = self.sock.makefile("rb")
+
+    def convert(self, mode, source, options=(), grid=None):
+        """Send one request; return a list of (extension, path, bytes or None), or raise RuntimeError.
+        With --stats, the last entry is ("stats", "-", the JSON line)."""
+        self.sock.sendall((" ".join([mode, source] + list(options)) + "\n").encode())
+        if grid is not None:
+            self.sock.sendall(grid)
+        header = self.file.readline().decode()
+        if not header:
+            raise RuntimeError("the daemon closed the connection")
+        words = header.split()
+        if words[0] != "ok":
+            raise RuntimeError(header.strip())
+        meshes = []
+        for _ in range(int(words[1])):
+            ext, size, path = self.file.readline().decode().split()
+            data = self.file.read(int(size)) if path == "-" else None
+            meshes.append((ext, path, data))
+        return meshes
+
+
+def read_grid(path):
+    """The size and cells of a .map file, as the daemon reads them after grid:WxH."""
+    with open(path, "rb") as f:
+        lines = f.read().split(b"\n")
+    header = {}
+    row = 0
+    while lines[row].strip() != b"map":
+        key, value = lines[row].split()
+        header[key.decode()] = value.decode()
+        row += 1
+    width, height = int(header["width"]), int(header["height"])
+    cells = b"".join(line.strip() for line in lines[row + 1:])
+    return width, height, cells[:width * height]
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Convert maps with a running conversion daemon.")
+    parser.add_argument("socket")
+    parser.add_argument("mode", choices=["rec", "cdt", "mcdt"])
+    parser.add_argument("map")
+    parser.add_argument("--send-grid", action="store_true", help="send the cells instead of the map path")
+    parser.add_argument("--save", help="write the meshes sent back to SAVE.rec, ... (implies --inline)")
+    parser.add_argument("--repeat", type=int, default=1, help="send the request this many times and time them")
+    parser.add_argument("--option", action="append", default=[], help="option for the conversion, e.g. --option=--direct")
+    args = parser.parse_args()
+
+    options = list(args.option)
+    if args.save:
+        options.append("--inline")
+    grid = None
+    source = args.map
+    if args.send_grid:
+        width, height, grid = read_grid(args.map)
+        source = "grid:%dx%d" % (width, height)
+
+    client = Client(args.socket)
+    times = []
+    for _ in range(args.repeat):
+        start = time.perf_counter()
+        try:
+            meshes = client.convert(args.mode, source, options, grid)
+        except RuntimeError as e:
+            sys.exit(str(e))
+        times.append(time.perf_counter() - start)
+    for ext, path, data in meshes:
+        if data is None:
+            print(path)
+        elif ext == "stats":
+            print(data.decode().strip())
+        elif args.save:
+            with open("%s.%s" % (args.save, ext), "wb") as f:
+                f.write(data)
+            print("%s.%s" % (args.save, ext))
+        else:
+            print("%s: %d bytes" % (ext, len(data)))
+    if args.repeat > 1:
+        times.sort()
+        print("%d requests: min %.1f ms, median %.1f ms, max %.1f ms" % (
+            len(times), times[0] * 1000, times[len(times) // 2] * 1000, times[-1] * 1000))
+
+
+if __name__ == "__main__":
+    main()
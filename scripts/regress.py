@@ -0,0 +1,234 @@
+#!/usr/bin/env python3
+#
+# Performance regression harness: converts a fixed corpus of maps with run --stats, several times each, and
+# either records the per-stage times, peak memory, polygon counts and output hashes as a baseline, or
+# compares a new build against one.
+#
+#   scripts/regress.py record  --baseline baseline.json      # on the build that is known good
+#   scripts/regress.py compare --baseline baseline.json      # on the new build; exits 1 on a regression
+#
+# A stage counts as slower only if its median time grew by more than --threshold of the baseline, by more
+# than --floor-ms and by more than three times the spread (median absolute deviation) of both runs, and
+# every new run of it was slower than every baseline run.
+#
+
+import argparse
+import hashlib
+import json
+import os
+import shutil
+import statistics
+import subprocess
+import sys
+import tempfile
+
+MODES = ["rec", "cdt", "mcdt"]
+OUTPUTS = {"rec": [".rec"], "cdt": [".cdt"], "mcdt": [".cdt", ".merged-cdt"]}
+# the counts that describe the output, which must not change between builds that only got faster
+MESH_COUNTS = ["rec.vertices", "rec.polygons", "cdt.vertices", "cdt.triangles", "merge.vertices",
+               "merge.polygons", "merge.dead_ends", "merge.sum_traversable"]
+GENERATED = ["noise", "maze", "rooms", "stairs", "open", "corridors"]
+
+
+def parse_list(text):
+    return [item for item in text.split(",") if item]
+
+
+def read_corpus(path):
+    entries = []
+    with open(path) as f:
+        for line in f:
+            line = line.split("#", 1)[0].strip()
+            if line:
+                entries.append(line)
+    return entries
+
+
+def sha256(path):
+    digest = hashlib.sha256()
+    with open(path, "rb") as f:
+        for block in iter(lambda: f.read(1 << 20), b""):
+            digest.update(block)
+    return digest.hexdigest()
+
+
+def spread(samples):
+    """Median absolute deviation, a noise estimate that one outlier does not move."""
+    middle = statistics.median(samples)
+    return statistics.median(abs(s - middle) for s in samples)
+
+
+def prepare_map(args, entry, work):
+    """Return the path of the map for a corpus entry inside the work directory, generating it if needed."""
+    name = entry.replace(":", "_").replace("/", "_")
+    if not name.endswith(".map"):
+        name += ".map"
+    path = os.path.join(work, name)
+    if entry.split(":", 1)[0] in GENERATED:
+        if not os.path.exists(path):
+            subprocess.run([args.mapgen, entry, path], check=True, stdout=subprocess.DEVNULL)
+    else:
+        source = os.path.join(args.root, entry)
+        if not os.path.exists(source):
+            sys.exit("corpus map %s not found" % source)
+        # run writes its meshes next to the map, so convert a copy in the work directory
+        if not os.path.exists(path):
+            shutil.copyfile(source, path)
+    return path
+
+
+def measure(args, map_path, mode):
+    """Convert one map args.repeats times; return the medians, spreads, counts and output hashes."""
+    base = map_path[:-len(".map")]
+    stats_path = base + ".stats.json"
+    runs = []
+    for _ in range(args.repeats):
+        if os.path.exists(stats_path):
+            os.remove(stats_path)
+        command = [args.run, "-" + mode, map_path, "--stats=" + stats_path] + args.option
+        result = subprocess.run(command, stdout=subprocess.DEVNULL, stderr=subprocess.PIPE, text=True)
+        if result.returncode != 0:
+            sys.exit("%s failed:\n%s" % (" ".join(command), result.stderr))
+        with open(stats_path) as f:
+            runs.append(json.loads(f.read().splitlines()[-1]))
+
+    stages = {}
+    for name in dict.fromkeys(s["name"] for run in runs for s in run["stages"]):
+        samples = [sum(s["wall_s"] for s in run["stages"] if s["name"] == name) * 1000 for run in runs]
+        stages[name] = {"median_ms": statistics.median(samples), "spread_ms": spread(samples), "samples_ms": samples}
+    totals = [sum(s["wall_s"] for s in run["stages"] if s["name"] != "verify") * 1000 for run in runs]
+    stages["total"] = {"median_ms": statistics.median(totals), "spread_ms": spread(totals), "samples_ms": totals}
+    rss = [run["peak_rss_kb"] for run in runs]
+    counts = runs[-1]["counts"]
+    return {
+        "stages": stages,
+        "peak_rss_kb": statistics.median(rss),
+        "counts": {name: counts[name] for name in MESH_COUNTS if name in counts},
+        "hashes": {ext: sha256(base + ext) for ext in OUTPUTS[mode]},
+    }
+
+
+def measure_corpus(args):
+    work = args.work or tempfile.mkdtemp(prefix="startkit-regress-")
+    os.makedirs(work, exist_ok=True)
+    results = {}
+    try:
+        for entry in read_corpus(args.corpus):
+            map_path = prepare_map(args, entry, work)
+            for mode in parse_list(args.modes):
+                result = measure(args, map_path, mode)
+                results["%s -%s" % (entry, mode)] = result
+                print("%-32s -%-4s %9.1f ms %8.1f MiB" % (entry, mode, result["stages"]["total"]["median_ms"],
+                                                          result["peak_rss_kb"] / 1024.0), flush=True)
+    finally:
+        if not args.work:
+            shutil.rmtree(work, ignore_errors=True)
+    return results
+
+
+def git_revision(root):
+    try:
+        return subprocess.run(["git", "-C", root, "rev-parse", "--short", "HEAD"], capture_output=True, text=True,
+                              check=True).stdout.strip()
+    except (OSError, subprocess.CalledProcessError):
+        return ""
+
+
+def slower(base, new, args):
+    """Did a stage get slower by more than the thresholds and the noise of both runs?"""
+    grew = new["median_ms"] - base["median_ms"]
+    noise = 3 * (base["spread_ms"] + new["spread_ms"])
+    # every new sample slower than every baseline one, so a single slow run cannot cause it
+    separate = min(new["samples_ms"]) > max(base["samples_ms"])
+    return separate and grew > max(args.threshold * base["median_ms"], args.floor_ms, noise)
+
+
+def compare(baseline, results, args):
+    regressions, notes = [], []
+    if baseline["options"] != args.option:
+        notes.append("baseline was recorded with options %s, this run used %s" % (baseline["options"], args.option))
+    for key, base in baseline["results"].items():
+        if key not in results:
+            continue
+        new = results[key]
+        for name, base_stage in base["stages"].items():
+            if name not in new["stages"]:
+                continue
+            new_stage = new["stages"][name]
+            change = "%s %s: %.1f -> %.1f ms (%+.0f%%)" % (
+                key, name, base_stage["median_ms"], new_stage["median_ms"],
+                100.0 * (new_stage["median_ms"] - base_stage["median_ms"]) / max(base_stage["median_ms"], 1e-9))
+            if slower(base_stage, new_stage, args):
+                regressions.append("slower  " + change)
+            elif slower(new_stage, base_stage, args):
+                notes.append("faster  " + change)
+        grew = new["peak_rss_kb"] - base["peak_rss_kb"]
+        if grew > max(args.memory_threshold * base["peak_rss_kb"], 1024):
+            regressions.append("memory  %s: %.1f -> %.1f MiB" % (key, base["peak_rss_kb"] / 1024.0,
+                                                                  new["peak_rss_kb"] / 1024.0))
+        changed = [name for name in base["counts"] if new["counts"].get(name) != base["counts"][name]]
+        for name in changed:
+            notes.append("count   %s %s: %s -> %s" % (key, name, base["counts"][name], new["counts"].get(name)))
+        for ext, digest in base["hashes"].items():
+            if new["hashes"].get(ext) != digest:
+                message = "output  %s: %s differs from the baseline" % (key, ext)
+                (notes if args.allow_output_change else regressions).append(message)
+    for key in results:
+        if key not in baseline["results"]:
+            notes.append("new     %s is not in the baseline" % key)
+    return regressions, notes
+
+
+def main():
+    root = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+    parser = argparse.ArgumentParser(description="Record or compare conversion time, memory and output over a corpus.")
+    parser.add_argument("command", choices=["record", "compare"])
+    parser.add_argument("--baseline", default="baseline.json", help="baseline file (default: baseline.json)")
+    parser.add_argument("--corpus", default=os.path.join(root, "scripts", "corpus.txt"),
+                        help="one .map path or mapgen spec per line (default: scripts/corpus.txt)")
+    parser.add_argument("--run", default=os.path.join(root, "run"), help="converter binary (default: ./run)")
+    parser.add_argument("--mapgen", default=os.path.join(root, "mapgen"), help="map generator (default: ./mapgen)")
+    parser.add_argument("--modes", default="rec,cdt,mcdt", help="mesh types, comma separated")
+    parser.add_argument("--repeats", type=int, default=5, help="conversions per map and mesh type (default: 5)")
+    parser.add_argument("--option", action="append", default=[], help="extra option for run, e.g. --option=--threads=4")
+    parser.add_argument("--threshold", type=float, default=0.10,
+                        help="relative slowdown of a stage that counts as a regression (default: 0.10)")
+    parser.add_argument("--floor-ms", type=float, default=5.0,
+                        help="ignore slowdowns smaller than this many milliseconds (default: 5)")
+    parser.add_argument("--memory-threshold", type=float, default=0.10,
+                        help="relative growth of peak RSS that counts as a regression (default: 0.10)")
+    parser.add_argument("--allow-output-change", action="store_true",
+                        help="report changed output hashes without failing")
+    parser.add_argument("--work", help="keep the maps and meshes in this directory (default: a temporary one)")
+    args = parser.parse_args()
+    args.root = root
+
+    for mode in parse_list(args.modes):
+        if mode not in MODES:
+            parser.error("unknown mode " + mode)
+    if args.repeats < 1:
+        parser.error("--repeats must be at least 1")
+
+    if args.command == "record":
+        results = measure_corpus(args)
+        with open(args.baseline, "w") as f:
+            json.dump({"revision": git_revision(root), "options": args.option, "repeats": args.repeats,
+                       "results": results}, f, indent=1, sort_keys=True)
+        print("wrote", args.baseline)
+        return 0
+
+    with open(args.baseline) as f:
+        baseline = json.load(f)
+    results = measure_corpus(args)
+    regressions, notes = compare(baseline, results, args)
+    for line in notes:
+        print(line)
+    for line in regressions:
+        print(line)
+    print("%d regressions against %s (revision %s)" % (len(regressions), args.baseline,
+                                                        baseline.get("revision") or "unknown"))
+    return 1 if regressions else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,148 @@
+#!/usr/bin/env python3
+#
+# Scaling benchmark: generates synthetic maps of growing size with mapgen, converts each with run for every
+# mesh type, and records the --stats time and memory of each stage against the cell count and the
+# obstacle-edge count. Writes scaling.csv and, when matplotlib is installed, one plot per mesh type.
+#
+# Example, from the repository root after "make fast":
+#   scripts/scaling.py --kinds noise,maze,rooms --sizes 512,1024,2048,4096 --out scaling
+#
+
+import argparse
+import csv
+import json
+import os
+import subprocess
+import sys
+
+MODES = ["rec", "cdt", "mcdt"]
+KINDS = ["noise", "maze", "rooms", "stairs", "open", "corridors"]
+FIELDS = ["kind", "width", "height", "cells", "obstacle_edges", "mode", "stage", "wall_s", "cpu_s", "calls",
+          "peak_rss_kb"]
+
+
+def parse_list(text):
+    return [item for item in text.split(",") if item]
+
+
+def run_one(args, map_path, mode, stats_path):
+    if os.path.exists(stats_path):
+        os.remove(stats_path)
+    command = [args.run, "-" + mode, map_path, "--stats=" + stats_path] + args.option
+    result = subprocess.run(command, stdout=subprocess.DEVNULL, stderr=subprocess.PIPE, text=True)
+    if result.returncode != 0:
+        sys.exit("%s failed:\n%s" % (" ".join(command), result.stderr))
+    with open(stats_path) as f:
+        return json.loads(f.read().splitlines()[-1])
+
+
+def measure(args):
+    os.makedirs(args.out, exist_ok=True)
+    rows = []
+    for kind in parse_list(args.kinds):
+        for size in [int(s) for s in parse_list(args.sizes)]:
+            map_path = os.path.join(args.out, "%s-%d.map" % (kind, size))
+            spec = "%s:%dx%d:%g:%d" % (kind, size, size, args.density, args.seed)
+            subprocess.run([args.mapgen, spec, map_path], check=True, stdout=subprocess.DEVNULL)
+            base = map_path[:-len(".map")]
+            for mode in parse_list(args.modes):
+                stats = run_one(args, map_path, mode, base + ".stats.json")
+                counts = stats["counts"]
+                for stage in stats["stages"]:
+                    rows.append({
+                        "kind": kind, "width": size, "height": size,
+                        "cells": counts.get("map.cells", size * size),
+                        "obstacle_edges": counts.get("map.obstacle_edges", ""),
+                        "mode": mode, "stage": stage["name"], "wall_s": stage["wall_s"], "cpu_s": stage["cpu_s"],
+                        "calls": stage["calls"], "peak_rss_kb": stats["peak_rss_kb"],
+                    })
+                total = sum(s["wall_s"] for s in stats["stages"] if s["name"] != "verify")
+                print("%-6s %6d %-4s %8.3f s %8.1f MiB" % (kind, size, mode, total, stats["peak_rss_kb"] / 1024.0),
+                      flush=True)
+            # the maps and meshes of the largest sizes take gigabytes
+            if not args.keep:
+                for suffix in [".map", ".poly", ".cdt", ".merged-cdt", ".rec", ".stats.json"]:
+                    if os.path.exists(base + suffix):
+                        os.remove(base + suffix)
+    return rows
+
+
+def plot(rows, out):
+    try:
+        import matplotlib
+        matplotlib.use("Agg")
+        import matplotlib.pyplot as plt
+    except ImportError:
+        print("matplotlib is not installed; wrote the CSV only")
+        return
+    markers = dict(zip(KINDS, "osD^vP"))
+    for mode in sorted({r["mode"] for r in rows}):
+        mode_rows = [r for r in rows if r["mode"] == mode]
+        stages = list(dict.fromkeys(r["stage"] for r in mode_rows))
+        kinds = list(dict.fromkeys(r["kind"] for r in mode_rows))
+        colours = {stage: "C%d" % (i % 10) for i, stage in enumerate(stages)}
+        fig, axes = plt.subplots(1, 3, figsize=(18, 6))
+        for stage in stages:
+            for kind in kinds:
+                points = sorted((r["cells"], r["obstacle_edges"], r["wall_s"])
+                                for r in mode_rows if r["stage"] == stage and r["kind"] == kind)
+                if not points:
+                    continue
+                style = dict(color=colours[stage], marker=markers.get(kind, "o"), markersize=4)
+                axes[0].plot([p[0] for p in points], [p[2] for p in points],
+                             label=stage if kind == kinds[0] else None, **style)
+                axes[1].plot([p[1] for p in points], [p[2] for p in points], **style)
+        for kind in kinds:
+            points = sorted({(r["cells"], r["peak_rss_kb"]) for r in mode_rows if r["kind"] == kind})
+            axes[2].plot([p[0] for p in points], [p[1] / 1024.0 for p in points], marker=markers.get(kind, "o"),
+                         label=kind)
+        titles = [("cells", "wall time per stage (s)"), ("obstacle edges", "wall time per stage (s)"),
+                  ("cells", "peak RSS (MiB)")]
+        for axis, (xlabel, ylabel) in zip(axes, titles):
+            axis.set_xscale("log")
+            axis.set_yscale("log")
+            axis.set_xlabel(xlabel)
+            axis.set_ylabel(ylabel)
+            axis.grid(True, which="both", alpha=0.3)
+        axes[0].legend(fontsize="small")
+        axes[2].legend(fontsize="small", title="markers")
+        fig.suptitle("-%s" % mode)
+        fig.tight_layout()
+        path = os.path.join(out, "scaling-%s.png" % mode)
+        fig.savefig(path, dpi=100)
+        print("wrote", path)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Time and memory per stage against map size for each mesh type.")
+    parser.add_argument("--run", default="./run", help="converter binary (default: ./run)")
+    parser.add_argument("--mapgen", default="./mapgen", help="map generator binary (default: ./mapgen)")
+    parser.add_argument("--kinds", default="noise,maze,rooms,stairs,open", help="map kinds, comma separated")
+    parser.add_argument("--sizes", default="256,512,1024,2048", help="square map sides, comma separated (up to 32768)")
+    parser.add_argument("--density", type=float, default=0.3, help="obstacle density passed to mapgen")
+    parser.add_argument("--seed", type=int, default=1)
+    parser.add_argument("--modes", default="rec,cdt,mcdt", help="mesh types, comma separated")
+    parser.add_argument("--option", action="append", default=[], help="extra option for run, e.g. --option=--threads=4")
+    parser.add_argument("--out", default="scaling", help="output directory (default: scaling)")
+    parser.add_argument("--keep", action="store_true", help="keep the generated maps and meshes")
+    args = parser.parse_args()
+
+    for mode in parse_list(args.modes):
+        if mode not in MODES:
+            parser.error("unknown mode " + mode)
+    for kind in parse_list(args.kinds):
+        if kind not in KINDS:
+            parser.error("unknown kind " + kind)
+
+    rows = measure(args)
+    path = os.path.join(args.out, "scaling.csv")
+    with open(path, "w", newline="") as f:
+        writer = csv.DictWriter(f, fieldnames=FIELDS)
+        writer.writeheader()
+        writer.writerows(rows)
+    print("wrote", path)
+    plot(rows, args.out)
+
+
+if __name__ == "__main__":
+    main()
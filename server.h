@@ -0,0 +1,563 @@
+//
+// The conversion daemon behind "run -serve SOCKET": a pool of worker processes that accept requests on a
+// Unix domain socket and convert them with converters that stay loaded between requests. The converters
+// keep their state in globals, so the pool is made of processes that each convert one map at a time,
+// forked before the first request and restarted if one dies.
+//
+// A request is one line, "MODE SOURCE [OPTION...]":
+//   MODE    rec, cdt or mcdt
+//   SOURCE  the path of a .map file, or grid:WxH followed after the newline by W * H cells, row by row,
+//           in .map characters ('.', 'G' and 'S' are traversable)
+//   OPTION  an option of run, "--out=PREFIX" to write the meshes to PREFIX.rec, ... instead of next to the
+//           map, or "--inline" to send the meshes back instead of writing them (the default for grid:).
+//           Options that name a file or directory of the daemon, such as --stats=FILE and --cache=DIR,
+//           can only be given when it starts.
+// The reply is "ok N SECONDS" and a line "EXT BYTES PATH" per mesh; an inline mesh has "-" for PATH and
+// its BYTES bytes follow the line. With --stats, the last of the N lines is "stats BYTES -" followed by
+// the JSON line. A request that cannot be converted, or whose meshes cannot be written, gets
+// "error MESSAGE"; if the converter exits, the connection is closed after the error. A connection can
+// carry any number of requests, one after the other.
+//
+// Meshes that are not sent back are only written under out_root (--out-root=DIR when the daemon starts,
+// its working directory by default); a request for anywhere else gets an error.
+//
+// The daemon process accepts the connections and watches the idle ones. When a request starts to arrive it
+// passes the connection to a free worker, which serves that request (and any that arrived behind it) and
+// hands the connection back, so idle clients never hold a worker. A request that stops arriving for
+// REQUEST_TIMEOUT_S seconds is dropped with its connection.
+//
+
+#ifndef STARTKIT_SERVER_H
+#define STARTKIT_SERVER_H
+#include <string>
+#include <vector>
+#include <functional>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <filesystem>
+#include <system_error>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <deque>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+
+namespace meshserver {
+    namespace fs = std::filesystem;
+    using std::string;
+    using std::vector;
+
+    int num_workers = 2;
+    const size_t MAX_LINE = 1 << 16;
+    const long long MAX_CELLS = 1LL << 31;
+    const int REQUEST_TIMEOUT_S = 10;
+    string out_root; // set by serve() to the working directory if empty
+
+    struct Request {
+        string mode;
+        string map;             // empty for an inline grid
+        vector<bool> grid;      // grid[y * width + x] is true for traversable cells
+        int width = 0, height = 0;
+        vector<string> options; // the options for run, without --out and --inline
+        string out;             // where the meshes go, without extension
+        bool send_meshes = false;
+    };
+
+    // Converts a request to the meshes at request.out + ".rec", ...; fills in their paths and the stats
+    // JSON to send back, if any, or error.
+    typedef std::function<bool(const Request&, vector<string>& written, string& stats, string& error)> Handler;
+
+    // Buffered reads from a connection.
+    class Connection {
+    public:
+        explicit Connection(int fd) : fd(fd) {}
+
+        bool read_line(string& line) {
+            line.clear();
+            for(;;){
+                if(begin == end && !fill()){
+                    return false;
+                }
+                const char* newline = (const char*)std::memchr(buffer + begin, '\n', end - begin);
+                const size_t take = (newline ? newline - buffer : end) - begin;
+                line.append(buffer + begin, take);
+                begin += take;
+                if(newline){
+                    begin++;
+                    return true;
+                }
+                if(line.size() > MAX_LINE){
+                    return false;
+                }
+            }
+        }
+
+        // the cells of an inline grid
+        bool read_grid(vector<bool>& grid, long long cells) {
+            grid.assign(cells, false);
+            for(long long i = 0; i < cells;){
+                if(begin == end && !fill()){
+                    return false;
+                }
+                for(; begin < end && i < cells; begin++, i++){
+                    const char c = buffer[begin];
+                    grid[i] = c == '.' || c == 'G' || c == 'S';
+                }
+            }
+            return true;
+        }
+
+        bool write(const char* data, size_t size) {
+            while(size > 0){
+                const ssize_t n = ::send(fd, data, size, MSG_NOSIGNAL);
+                if(n < 0 && errno == EINTR){
+                    continue;
+                }
+                if(n <= 0){
+                    return false;
+                }
+                data += n;
+                size -= n;
+            }
+            return true;
+        }
+
+        bool write(const string& s) {
+            return write(s.data(), s.size());
+        }
+
+        // Has more of the stream been read than handed out?
+        bool buffered() const {
+            return begin < end;
+        }
+
+        bool write_file(const string& path) {
+            std::ifstream in(path, std::ios::binary);
+            char chunk[1 << 16];
+            while(in.read(chunk, sizeof chunk) || in.gcount() > 0){
+                if(!write(chunk, in.gcount())){
+                    return false;
+                }
+            }
+            return true;
+        }
+
+    private:
+        bool fill() {
+            ssize_t n;
+            do {
+                n = ::read(fd, buffer, sizeof buffer);
+            } while(n < 0 && errno == EINTR);
+            begin = 0;
+            end = n > 0 ? n : 0;
+            return n > 0;
+        }
+
+        int fd;
+        char buffer[1 << 16];
+        size_t begin = 0, end = 0;
+    };
+
+    // Is path in dir or below it, once "..", "." and symbolic links are resolved?
+    bool inside(const string& path, const string& dir) {
+        std::error_code ec;
+        const fs::path p = fs::weakly_canonical(fs::absolute(path, ec), ec);
+        const fs::path d = fs::weakly_canonical(fs::absolute(dir, ec), ec);
+        if(ec){
+            return false;
+        }
+        auto i = p.begin();
+        for(auto j = d.begin(); j != d.end(); ++i, ++j){
+            if(i == p.end() || *i != *j) return false;
+        }
+        return true;
+    }
+
+    // Parse a request line, and read its grid if it has one. Returns false with error set for a request
+    // that cannot be converted, or with error empty if the connection cannot go on.
+    bool read_request(Connection& conn, const string& line, const string& scratch, Request& request,
+                      string& error) {
+        std::istringstream words(line);
+        string source, word;
+        words >> request.mode >> source;
+        bool send_meshes = false;
+        while(words >> word){
+            if(word.rfind("--out=", 0) == 0) request.out = word.substr(6);
+            else if(word == "--inline") send_meshes = true;
+            else request.options.push_back(word);
+        }
+        if(source.rfind("grid:", 0) == 0){
+            long long cells = 0;
+            if(std::sscanf(source.c_str() + 5, "%dx%d", &request.width, &request.height) != 2 ||
+               request.width < 1 || request.height < 1 ||
+               (cells = (long long)request.width * request.height) > MAX_CELLS){
+                // the cells that follow cannot be skipped
+                conn.write("error bad grid size in " + source + "\n");
+                return false;
+            }
+            if(!conn.read_grid(request.grid, cells)){
+                return false;
+            }
+            send_meshes = send_meshes || request.out.empty();
+        }else{
+            request.map = source;
+        }
+        if(request.mode != "rec" && request.mode != "cdt" && request.mode != "mcdt"){
+            error = "unknown mesh type " + request.mode;
+            return false;
+        }
+        if(request.map.empty() && request.grid.empty()){
+            error = "no map";
+            return false;
+        }
+        request.send_meshes = send_meshes;
+        if(send_meshes){
+            request.out = scratch + "/mesh";
+        }else{
+            if(request.out.empty()){
+                request.out = fs::path(request.map).replace_extension().string();
+            }
+            if(!inside(request.out, out_root)){
+                error = "cannot write outside " + out_root + ": " + request.out;
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Remove the files in dir, but not dir.
+    void clear_dir(const string& dir) {
+        std::error_code ec;
+        for(const auto& entry : fs::directory_iterator(dir, ec)){
+            fs::remove_all(entry.path(), ec);
+        }
+    }
+
+    // Serve the request that has started to arrive on conn, and the ones already read behind it. Returns false
+    // once the connection is closed or broken.
+    bool serve_requests(Connection& conn, const string& scratch, const Handler& handler) {
+        string line;
+        do {
+            if(!conn.read_line(line)){
+                return false;
+            }
+            if(line.empty()){
+                continue;
+            }
+            const auto start = std::chrono::steady_clock::now();
+            Request request;
+            vector<string> written;
+            string stats, error;
+            if(!read_request(conn, line, scratch, request, error)){
+                if(error.empty() || !conn.write("error " + error + "\n")){
+                    return false;
+                }
+                continue;
+            }
+            // the converters do not report a mesh they could not write, so look for every one
+            bool converted = handler(request, written, stats, error);
+            for(const auto& path : written){
+                std::error_code ec;
+                if(converted && (!fs::is_regular_file(path, ec) || !std::ifstream(path, std::ios::binary))){
+                    error = "cannot write " + path;
+                    converted = false;
+                }
+            }
+            bool sent;
+            if(!converted){
+                sent = conn.write("error " + (error.empty() ? string("conversion failed") : error) + "\n");
+            }else{
+                char header[64];
+                std::snprintf(header, sizeof header, "ok %zu %.6f\n", written.size() + (stats.empty() ? 0 : 1),
+                              std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+                sent = conn.write(header);
+                for(const auto& path : written){
+                    std::error_code ec;
+                    const auto size = fs::file_size(path, ec);
+                    sent = sent && conn.write(fs::path(path).extension().string().substr(1) + " " +
+                                              std::to_string(ec ? 0 : size) + " " +
+                                              (request.send_meshes ? string("-") : path) + "\n");
+                    sent = sent && (!request.send_meshes || conn.write_file(path));
+                }
+                if(!stats.empty()){
+                    sent = sent && conn.write("stats " + std::to_string(stats.size()) + " -\n" + stats);
+                }
+            }
+            if(request.send_meshes){
+                // the meshes, and the .poly file the CDT path writes next to them
+                clear_dir(scratch);
+            }
+            if(!sent){
+                return false;
+            }
+        } while(conn.buffered());
+        return true;
+    }
+
+    // inline meshes are written here, and removed after each request
+    fs::path scratch_dir(pid_t worker) {
+        return fs::temp_directory_path() / ("startkit-serve-" + std::to_string(worker));
+    }
+
+    // Pass fd over the Unix socket channel.
+    bool send_fd(int channel, int fd) {
+        char tag = 'r';
+        iovec data = {&tag, 1};
+        char control[CMSG_SPACE(sizeof(int))] = {};
+        msghdr message = {};
+        message.msg_iov = &data;
+        message.msg_iovlen = 1;
+        message.msg_control = control;
+        message.msg_controllen = sizeof control;
+        cmsghdr* header = CMSG_FIRSTHDR(&message);
+        header->cmsg_level = SOL_SOCKET;
+        header->cmsg_type = SCM_RIGHTS;
+        header->cmsg_len = CMSG_LEN(sizeof(int));
+        std::memcpy(CMSG_DATA(header), &fd, sizeof fd);
+        return sendmsg(channel, &message, MSG_NOSIGNAL) == 1;
+    }
+
+    // The file descriptor sent with send_fd, or -1 once the channel is closed.
+    int receive_fd(int channel) {
+        char tag;
+        iovec data = {&tag, 1};
+        char control[CMSG_SPACE(sizeof(int))] = {};
+        msghdr message = {};
+        message.msg_iov = &data;
+        message.msg_iovlen = 1;
+        message.msg_control = control;
+        message.msg_controllen = sizeof control;
+        ssize_t n;
+        do {
+            n = recvmsg(channel, &message, 0);
+        } while(n < 0 && errno == EINTR);
+        cmsghdr* header = CMSG_FIRSTHDR(&message);
+        if(n != 1 || header == nullptr || header->cmsg_type != SCM_RIGHTS){
+            return -1;
+        }
+        int fd;
+        std::memcpy(&fd, CMSG_DATA(header), sizeof fd);
+        return fd;
+    }
+
+    // Serve the connections the daemon passes over channel, answering 'k' to keep one or 'c' once it is closed.
+    void worker(int channel, const Handler& handler) {
+        std::signal(SIGTERM, SIG_DFL);
+        std::signal(SIGINT, SIG_DFL);
+        const string scratch = scratch_dir(getpid()).string();
+        std::error_code ec;
+        fs::create_directories(scratch, ec);
+        for(;;){
+            const int fd = receive_fd(channel);
+            if(fd < 0){
+                return;
+            }
+            Connection conn(fd);
+            const char done = serve_requests(conn, scratch, handler) ? 'k' : 'c';
+            close(fd);
+            if(::write(channel, &done, 1) != 1){
+                return;
+            }
+        }
+    }
+
+    volatile std::sig_atomic_t stopping = 0;
+
+    void stop(int) {
+        stopping = 1;
+    }
+
+    // Listen on socket_path and convert requests with num_workers worker processes until SIGINT or SIGTERM.
+    int serve(const string& socket_path, const Handler& handler) {
+        sockaddr_un address = {};
+        address.sun_family = AF_UNIX;
+        if(socket_path.size() >= sizeof address.sun_path){
+            std::fprintf(stderr, "Socket path %s is too long\n", socket_path.c_str());
+            return 1;
+        }
+        std::strcpy(address.sun_path, socket_path.c_str());
+        std::error_code ec;
+        const fs::path root = fs::canonical(out_root.empty() ? fs::current_path(ec) : fs::path(out_root), ec);
+        if(ec || !fs::is_directory(root)){
+            std::fprintf(stderr, "No directory %s for the meshes\n", out_root.c_str());
+            return 1;
+        }
+        out_root = root.string();
+        const int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+        // a socket file left by a daemon that was killed
+        unlink(socket_path.c_str());
+        if(listener < 0 || bind(listener, (sockaddr*)&address, sizeof address) != 0 || listen(listener, 128) != 0){
+            std::fprintf(stderr, "Cannot listen on %s: %s\n", socket_path.c_str(), std::strerror(errno));
+            return 1;
+        }
+
+        struct sigaction action = {};
+        action.sa_handler = stop;
+        sigaction(SIGINT, &action, nullptr);
+        sigaction(SIGTERM, &action, nullptr);
+
+        struct Worker {
+            pid_t pid = -1;
+            int channel = -1;
+            int conn = -1; // the connection it is serving, or -1 when it is free
+        };
+        vector<Worker> workers(std::max(1, num_workers));
+        vector<int> idle;     // connections waiting for their next request
+        std::deque<int> ready; // connections with a request arriving, waiting for a free worker
+        auto start_worker = [&](Worker& w) {
+            int pair[2];
+            if(socketpair(AF_UNIX, SOCK_STREAM, 0, pair) != 0){
+                return false;
+            }
+            const pid_t pid = fork();
+            if(pid == 0){
+                // the worker only keeps its end of the channel; a connection it inherited would stay open
+                // after the daemon closed it
+                close(listener);
+                close(pair[0]);
+                for(const auto& other : workers){
+                    if(other.channel >= 0) close(other.channel);
+                    if(other.conn >= 0) close(other.conn);
+                }
+                for(int fd : idle) close(fd);
+                for(int fd : ready) close(fd);
+                worker(pair[1], handler);
+                _exit(0);
+            }
+            close(pair[1]);
+            if(pid < 0){
+                close(pair[0]);
+                return false;
+            }
+            w.pid = pid;
+            w.channel = pair[0];
+            w.conn = -1;
+            return true;
+        };
+        for(auto& w : workers){
+            if(!start_worker(w)){
+                std::fprintf(stderr, "Cannot start a worker: %s\n", std::strerror(errno));
+                return 1;
+            }
+        }
+        std::fprintf(stderr, "Listening on %s with %zu workers, writing meshes under %s\n", socket_path.c_str(),
+                     workers.size(), out_root.c_str());
+
+        vector<pollfd> polled;
+        while(!stopping){
+            // hand waiting requests to free workers
+            for(auto& w : workers){
+                if(ready.empty()){
+                    break;
+                }
+                if(w.conn == -1){
+                    w.conn = ready.front();
+                    ready.pop_front();
+                    if(!send_fd(w.channel, w.conn)){
+                        close(w.conn);
+                        w.conn = -1;
+                    }
+                }
+            }
+
+            polled.clear();
+            polled.push_back({listener, POLLIN, 0});
+            for(const auto& w : workers){
+                polled.push_back({w.channel, POLLIN, 0});
+            }
+            for(int fd : idle){
+                polled.push_back({fd, POLLIN, 0});
+            }
+            if(poll(polled.data(), polled.size(), -1) < 0 || stopping){
+                continue;
+            }
+
+            // connections with something to read (or a hang-up, which a worker reads as the end)
+            vector<int> still_idle;
+            size_t p = 1 + workers.size();
+            for(int fd : idle){
+                if(polled[p++].revents != 0) ready.push_back(fd);
+                else still_idle.push_back(fd);
+            }
+            idle.swap(still_idle);
+
+            // workers done with a connection, or gone; the connections they hand back are polled from the next round
+            for(size_t i = 0; i < workers.size(); i++){
+                Worker& w = workers[i];
+                if(polled[1 + i].revents == 0){
+                    continue;
+                }
+                char done;
+                ssize_t n;
+                do {
+                    n = ::read(w.channel, &done, 1);
+                } while(n < 0 && errno == EINTR);
+                if(n == 1){
+                    if(w.conn >= 0){
+                        if(done == 'k') idle.push_back(w.conn);
+                        else close(w.conn);
+                    }
+                    w.conn = -1;
+                    continue;
+                }
+                int status = 0;
+                waitpid(w.pid, &status, 0);
+                std::fprintf(stderr, "Worker %d exited with status %d, starting another\n", (int)w.pid,
+                             WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status));
+                std::error_code ec;
+                fs::remove_all(scratch_dir(w.pid), ec);
+                close(w.channel);
+                if(w.conn >= 0){
+                    // the worker died converting a request on it
+                    const char message[] = "error the worker converting the request exited\n";
+                    ::send(w.conn, message, sizeof message - 1, MSG_NOSIGNAL);
+                    close(w.conn);
+                }
+                w = Worker();
+                if(!start_worker(w)){
+                    std::fprintf(stderr, "Cannot start a worker: %s\n", std::strerror(errno));
+                    stopping = 1;
+                }
+            }
+            if(polled[0].revents & POLLIN){
+                const int fd = accept(listener, nullptr, nullptr);
+                if(fd >= 0){
+                    // a client that stalls in the middle of a request or a reply gives up its worker
+                    timeval timeout = {REQUEST_TIMEOUT_S, 0};
+                    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof timeout);
+                    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof timeout);
+                    idle.push_back(fd);
+                }
+            }
+        }
+
+        for(const auto& w : workers){
+            if(w.pid > 0){
+                kill(w.pid, SIGTERM);
+            }
+        }
+        for(const auto& w : workers){
+            if(w.pid > 0){
+                waitpid(w.pid, nullptr, 0);
+                std::error_code ec;
+                fs::remove_all(scratch_dir(w.pid), ec);
+            }
+            if(w.channel >= 0) close(w.channel);
+            if(w.conn >= 0) close(w.conn);
+        }
+        for(int fd : idle) close(fd);
+        for(int fd : ready) close(fd);
+        close(listener);
+        unlink(socket_path.c_str());
+        return 0;
+    }
+}
+
+#endif //STARTKIT_SERVER_H
@@ -0,0 +1,148 @@
+//
+// Where a conversion spends its time and memory: per-stage wall and CPU time, peak RSS and counts,
+// written as one JSON line per map for --stats.
+//
+
+#ifndef STARTKIT_STATS_H
+#define STARTKIT_STATS_H
+#include <string>
+#include <vector>
+#include <utility>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <ctime>
+#include <cstdio>
+#include <ostream>
+#include <sys/resource.h>
+
+namespace stats {
+    using std::string;
+    using std::vector;
+
+    struct Stage {
+        string name;
+        double wall = 0, cpu = 0;
+        long long calls = 0;
+    };
+
+    // in the order they first ran
+    vector<Stage> stages;
+    vector<std::pair<string, long long>> counts;
+    std::mutex stats_mutex;
+    const std::thread::id main_thread = std::this_thread::get_id();
+
+    inline double cpu_seconds(clockid_t clock) {
+        timespec t;
+        clock_gettime(clock, &t);
+        return t.tv_sec + t.tv_nsec * 1e-9;
+    }
+
+    // A stage that runs more than once, or on several threads at a time, adds up.
+    void add_stage(const string& name, double wall, double cpu) {
+        std::lock_guard<std::mutex> guard(stats_mutex);
+        for(auto& s : stages){
+            if(s.name == name){
+                s.wall += wall;
+                s.cpu += cpu;
+                s.calls++;
+                return;
+            }
+        }
+        stages.push_back({name, wall, cpu, 1});
+    }
+
+    void count(const string& name, long long value) {
+        std::lock_guard<std::mutex> guard(stats_mutex);
+        for(auto& c : counts){
+            if(c.first == name){
+                c.second = value;
+                return;
+            }
+        }
+        counts.emplace_back(name, value);
+    }
+
+    // Forget the stages and counts so far, for a process that converts more than one map.
+    void reset() {
+        std::lock_guard<std::mutex> guard(stats_mutex);
+        stages.clear();
+        counts.clear();
+    }
+
+    // Times the enclosing block as a stage. On the main thread the CPU time is the whole process's, so it
+    // includes the workers the stage starts; on a worker it is that thread's own.
+    class Scope {
+    public:
+        explicit Scope(const char* name) :
+                name(name), clock(std::this_thread::get_id() == main_thread ? CLOCK_PROCESS_CPUTIME_ID
+                                                                            : CLOCK_THREAD_CPUTIME_ID),
+                wall_start(std::chrono::steady_clock::now()), cpu_start(cpu_seconds(clock)) {}
+
+        ~Scope() {
+            const double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - wall_start).count();
+            add_stage(name, wall, cpu_seconds(clock) - cpu_start);
+        }
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        const char* name;
+        clockid_t clock;
+        std::chrono::steady_clock::time_point wall_start;
+        double cpu_start;
+    };
+
+    // in KiB, for the whole run so far
+    long peak_rss_kb() {
+        rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        return usage.ru_maxrss;
+    }
+
+    void write_string(std::ostream& out, const string& s) {
+        out << '"';
+        for(char c : s){
+            if(c == '"' || c == '\\'){
+                out << '\\' << c;
+            }else if((unsigned char)c < 0x20){
+                char escaped[8];
+                std::snprintf(escaped, sizeof escaped, "\\u%04x", c);
+                out << escaped;
+            }else{
+                out << c;
+            }
+        }
+        out << '"';
+    }
+
+    // {"map": ..., "mode": ..., "peak_rss_kb": ..., "stages": [{"name", "wall_s", "cpu_s", "calls"}...],
+    //  "counts": {...}} on one line
+    void write_json(std::ostream& out, const string& map, const string& mode) {
+        std::lock_guard<std::mutex> guard(stats_mutex);
+        char number[32];
+        out << "{\"map\": ";
+        write_string(out, map);
+        out << ", \"mode\": ";
+        write_string(out, mode);
+        out << ", \"peak_rss_kb\": " << peak_rss_kb() << ", \"stages\": [";
+        for(size_t i = 0; i < stages.size(); i++){
+            out << (i == 0 ? "" : ", ") << "{\"name\": ";
+            write_string(out, stages[i].name);
+            std::snprintf(number, sizeof number, "%.6f", stages[i].wall);
+            out << ", \"wall_s\": " << number;
+            std::snprintf(number, sizeof number, "%.6f", stages[i].cpu);
+            out << ", \"cpu_s\": " << number << ", \"calls\": " << stages[i].calls << "}";
+        }
+        out << "], \"counts\": {";
+        for(size_t i = 0; i < counts.size(); i++){
+            out << (i == 0 ? "" : ", ");
+            write_string(out, counts[i].first);
+            out << ": " << counts[i].second;
+        }
+        out << "}}\n";
+    }
+}
+
+#endif //STARTKIT_STATS_H
@@ -0,0 +1,320 @@
+//
+// Parallel Delaunay triangulation of a point set, one vertical strip per thread.
+//
+
+#ifndef STARTKIT_STRIPCDT_H
+#define STARTKIT_STRIPCDT_H
+/*
+insertVertices of the CDT library is a sequential incremental loop, so one
+large component keeps a single core busy however many there are. Here the
+points are cut into vertical strips of equal size, and every strip is
+triangulated on its own thread inside one shared super-triangle.
+
+A strip triangle whose circumcircle lies inside the strip's x-range cannot
+contain a point of any other strip, so it is a triangle of the Delaunay
+triangulation of all points and is kept as it is. The remaining triangles
+form a narrow seam along the strip borders and the hull. The seam is
+triangulated again, with only the vertices on it and with the borders of the
+kept triangles as constraint edges, and its triangles outside the kept areas
+are stitched to the kept ones. The result is loaded into a CDT::Triangulation
+so constraint edges are inserted afterwards exactly as before.
+*/
+#include "counters.h"
+#include "CDT.h"
+#include "trace.h"
+#include <vector>
+#include <array>
+#include <algorithm>
+#include <unordered_map>
+#include <thread>
+#include <mutex>
+#include <exception>
+#include <cmath>
+#include <cstdint>
+
+namespace stripcdt {
+    typedef CDT::Triangulation<double> Triangulation;
+    typedef CDT::V2d<double> Point;
+
+    // components with fewer points than this per strip are not worth splitting
+    const size_t MIN_STRIP_POINTS = 20000;
+
+    // Start an empty triangulation inside the given super-triangle.
+    void init_frame(Triangulation& cdt, const std::vector<Point>& frame){
+        cdt.vertices = frame;
+        const CDT::Triangle super_triangle = {
+                {CDT::VertInd(0), CDT::VertInd(1), CDT::VertInd(2)},
+                {CDT::noNeighbor, CDT::noNeighbor, CDT::noNeighbor}};
+        cdt.triangles.assign(1, super_triangle);
+        cdt.VertTrisInternal().assign(3, CDT::TriInd(0));
+        cdt.initializedWithSuperTriangle();
+    }
+
+    // The library's super-triangle around all the points.
+    std::vector<Point> make_frame(const std::vector<Point>& points){
+        const CDT::Box2d<double> box = CDT::envelopBox(points);
+        const Point center = Point::make((box.min.x + box.max.x) / 2, (box.min.y + box.max.y) / 2);
+        const double w = box.max.x - box.min.x;
+        const double h = box.max.y - box.min.y;
+        const double r = std::sqrt(w * w + h * h) / 2 * 1.1;
+        const double R = 2 * r;
+        const double shift_x = R * std::sqrt(3.0) / 2;
+        return {Point::make(center.x - shift_x, center.y - r),
+                Point::make(center.x + shift_x, center.y - r),
+                Point::make(center.x, center.y + R)};
+    }
+
+    // Does the circumcircle of the triangle lie strictly between x = lo and x = hi?
+    bool circle_within(const Point& a, const Point& b, const Point& c, double lo, double hi){
+        const double bx = b.x - a.x, by = b.y - a.y;
+        const double cx = c.x - a.x, cy = c.y - a.y;
+        const double d = 2 * (bx * cy - by * cx);
+        if(d == 0){
+            return false;
+        }
+        const double b2 = bx * bx + by * by, c2 = cx * cx + cy * cy;
+        const double ux = (cy * b2 - by * c2) / d;
+        const double uy = (bx * c2 - cx * b2) / d;
+        const double r = std::sqrt(ux * ux + uy * uy);
+        const double x = a.x + ux;
+        // stay clear of rounding: a wrongly kept triangle would only cost the Delaunay property, not validity
+        const double margin = 1e-9 * (std::fabs(x) + r + 1);
+        return x - r > lo + margin && x + r < hi - margin;
+    }
+
+    // A side of a kept triangle on the border of the kept area, directed so the kept triangle is on its left.
+    struct BorderSide
+    {
+        CDT::VertInd a, b;
+        CDT::TriInd tri; // index among the strip's kept triangles
+        int slot;        // neighbour slot of the side in that triangle
+    };
+
+    struct Strip
+    {
+        CDT::TriangleVec kept;         // vertices in final numbering, neighbours in strip-kept numbering
+        std::vector<BorderSide> sides;
+        std::vector<uint32_t> seam;    // points on the seam
+    };
+
+    void triangulate_strip(const std::vector<Point>& points, const std::vector<uint32_t>& order, size_t first,
+                           size_t last, Strip& strip){
+        TRACE_SCOPE("triangulate_strip");
+        // a fresh triangulation gets its own super-triangle and the fast first-time insertion order; its
+        // triangles touching the super-triangle are never kept anyway
+        Triangulation cdt;
+        std::vector<Point> local(last - first);
+        for(size_t j = first; j < last; j++){
+            local[j - first] = points[order[j]];
+        }
+        cdt.insertVertices(local);
+        double lo = local[0].x, hi = local[0].x;
+        for(const auto& p : local){
+            lo = std::min(lo, p.x);
+            hi = std::max(hi, p.x);
+        }
+        // strip vertex 3 + j is point order[first + j], which is vertex 3 + order[first + j] in the final numbering
+        auto final_vertex = [&](CDT::VertInd v){
+            return v < 3 ? v : CDT::VertInd(order[first + v - 3] + 3);
+        };
+
+        const auto& tris = cdt.triangles;
+        std::vector<CDT::TriInd> kept_index(tris.size(), CDT::noNeighbor);
+        std::vector<char> on_seam(cdt.vertices.size(), 0);
+        for(CDT::TriInd t = 0; t < tris.size(); t++){
+            const auto& v = tris[t].vertices;
+            if(v[0] >= 3 && v[1] >= 3 && v[2] >= 3 &&
+               circle_within(cdt.vertices[v[0]], cdt.vertices[v[1]], cdt.vertices[v[2]], lo, hi)){
+                kept_index[t] = strip.kept.size();
+                strip.kept.push_back(tris[t]);
+            }else{
+                on_seam[v[0]] = on_seam[v[1]] = on_seam[v[2]] = 1;
+            }
+        }
+        for(CDT::VertInd v = 3; v < on_seam.size(); v++){
+            if(on_seam[v]){
+                strip.seam.push_back(order[first + v - 3]);
+            }
+        }
+        for(CDT::TriInd k = 0; k < strip.kept.size(); k++){
+            auto& tri = strip.kept[k];
+            for(int i = 0; i < 3; i++){
+                const CDT::TriInd n = tri.neighbors[i];
+                tri.neighbors[i] = n == CDT::noNeighbor ? CDT::noNeighbor : kept_index[n];
+                if(tri.neighbors[i] == CDT::noNeighbor){
+                    strip.sides.push_back({final_vertex(tri.vertices[i]), final_vertex(tri.vertices[(i + 1) % 3]), k, i});
+                }
+            }
+            for(auto& v : tri.vertices){
+                v = final_vertex(v);
+            }
+        }
+    }
+
+    // Insert the points into the empty triangulation cdt, using the given number of strips and threads.
+    // Afterwards cdt is in the same state as after cdt.insertVertices(points): vertex 3 + i is points[i].
+    void insertVertices(Triangulation& cdt, const std::vector<Point>& points, int strips){
+        const size_t n = points.size();
+        const std::vector<Point> frame = make_frame(points);
+        std::vector<uint32_t> order(n);
+        for(uint32_t i = 0; i < n; i++){
+            order[i] = i;
+        }
+        // cut into strips of about equal size, never between points with the same x
+        std::vector<size_t> cut(1, 0);
+        for(int s = 1; s < strips; s++){
+            const size_t c = std::max(n * s / strips, cut.back());
+            if(c >= n){
+                break;
+            }
+            std::nth_element(order.begin() + cut.back(), order.begin() + c, order.end(), [&points](uint32_t a, uint32_t b){
+                return points[a].x < points[b].x;
+            });
+            // everything before c is at most x; keep the points at exactly x on the right of the cut
+            const double x = points[order[c]].x;
+            const size_t left = std::partition(order.begin() + cut.back(), order.begin() + c, [&points, x](uint32_t i){
+                return points[i].x < x;
+            }) - order.begin();
+            if(left > cut.back()){
+                cut.push_back(left);
+            }
+        }
+        cut.push_back(n);
+
+        std::vector<Strip> results(cut.size() - 1);
+        std::vector<std::thread> workers;
+        std::exception_ptr error;
+        std::mutex error_mutex;
+        for(size_t s = 0; s < results.size(); s++){
+            workers.emplace_back([&, s](){
+                try{
+                    triangulate_strip(points, order, cut[s], cut[s + 1], results[s]);
+                }catch(...){
+                    std::lock_guard<std::mutex> lock(error_mutex);
+                    error = std::current_exception();
+                }
+            });
+        }
+        for(auto& worker : workers){
+            worker.join();
+        }
+        if(error){
+            std::rethrow_exception(error);
+        }
+
+        // Triangulate the seam with the borders of the kept areas as constraints.
+        std::vector<uint32_t> seam;
+        std::vector<size_t> kept_offset(results.size() + 1, 0);
+        for(size_t s = 0; s < results.size(); s++){
+            seam.insert(seam.end(), results[s].seam.begin(), results[s].seam.end());
+            kept_offset[s + 1] = kept_offset[s] + results[s].kept.size();
+        }
+        std::vector<uint32_t> seam_index(n, UINT32_MAX);
+        std::vector<Point> seam_points(seam.size());
+        for(uint32_t k = 0; k < seam.size(); k++){
+            seam_index[seam[k]] = k;
+            seam_points[k] = points[seam[k]];
+        }
+        Triangulation seam_cdt;
+        init_frame(seam_cdt, frame);
+        seam_cdt.insertVertices(seam_points);
+        std::vector<CDT::Edge> borders;
+        std::unordered_map<uint64_t, std::pair<size_t, const BorderSide*>> border_of;
+        auto side_key = [](CDT::VertInd a, CDT::VertInd b){ return (uint64_t)a << 32 | b; };
+        for(size_t s = 0; s < results.size(); s++){
+            for(const auto& side : results[s].sides){
+                borders.push_back(CDT::Edge(seam_index[side.a - 3], seam_index[side.b - 3]));
+                border_of[side_key(side.a, side.b)] = std::make_pair(s, &side);
+            }
+        }
+        seam_cdt.insertEdges(borders);
+
+        // Seam triangles on the kept side of a border lie over kept triangles: drop them and everything
+        // reachable from them without crossing a border.
+        auto final_vertex = [&seam](CDT::VertInd v){
+            return v < 3 ? v : CDT::VertInd(seam[v - 3] + 3);
+        };
+        auto& seam_tris = seam_cdt.triangles;
+        for(auto& tri : seam_tris){
+            for(auto& v : tri.vertices){
+                v = final_vertex(v);
+            }
+        }
+        std::vector<char> dropped(seam_tris.size(), 0);
+        std::vector<CDT::TriInd> stack;
+        for(CDT::TriInd t = 0; t < seam_tris.size(); t++){
+            const auto& v = seam_tris[t].vertices;
+            for(int i = 0; i < 3 && !dropped[t]; i++){
+                if(border_of.count(side_key(v[i], v[(i + 1) % 3]))){
+                    dropped[t] = 1;
+                    stack.push_back(t);
+                }
+            }
+        }
+        while(!stack.empty()){
+            const CDT::TriInd t = stack.back();
+            stack.pop_back();
+            const auto& tri = seam_tris[t];
+            for(int i = 0; i < 3; i++){
+                const CDT::TriInd nb = tri.neighbors[i];
+                if(nb != CDT::noNeighbor && !dropped[nb] &&
+                   !border_of.count(side_key(tri.vertices[i], tri.vertices[(i + 1) % 3]))){
+                    dropped[nb] = 1;
+                    stack.push_back(nb);
+                }
+            }
+        }
+
+        // Assemble: kept triangles strip by strip, then the remaining seam triangles.
+        CDT::TriangleVec& triangles = cdt.triangles;
+        triangles.clear();
+        triangles.reserve(kept_offset.back() + seam_tris.size());
+        for(size_t s = 0; s < results.size(); s++){
+            for(auto tri : results[s].kept){
+                for(auto& nb : tri.neighbors){
+                    if(nb != CDT::noNeighbor){
+                        nb += kept_offset[s];
+                    }
+                }
+                triangles.push_back(tri);
+            }
+            CDT::TriangleVec().swap(results[s].kept);
+        }
+        std::vector<CDT::TriInd> seam_final(seam_tris.size(), CDT::noNeighbor);
+        for(CDT::TriInd t = 0; t < seam_tris.size(); t++){
+            if(!dropped[t]){
+                seam_final[t] = triangles.size();
+                triangles.push_back(seam_tris[t]);
+            }
+        }
+        for(CDT::TriInd t = 0; t < seam_tris.size(); t++){
+            if(dropped[t]){
+                continue;
+            }
+            auto& tri = triangles[seam_final[t]];
+            for(int i = 0; i < 3; i++){
+                auto found = border_of.find(side_key(tri.vertices[(i + 1) % 3], tri.vertices[i]));
+                if(found != border_of.end()){
+                    const CDT::TriInd kept = kept_offset[found->second.first] + found->second.second->tri;
+                    tri.neighbors[i] = kept;
+                    triangles[kept].neighbors[found->second.second->slot] = seam_final[t];
+                }else if(tri.neighbors[i] != CDT::noNeighbor){
+                    tri.neighbors[i] = seam_final[tri.neighbors[i]];
+                }
+            }
+        }
+
+        cdt.vertices = frame;
+        cdt.vertices.insert(cdt.vertices.end(), points.begin(), points.end());
+        auto& vert_tris = cdt.VertTrisInternal();
+        vert_tris.assign(cdt.vertices.size(), CDT::noNeighbor);
+        for(CDT::TriInd t = 0; t < triangles.size(); t++){
+            for(auto v : triangles[t].vertices){
+                vert_tris[v] = t;
+            }
+        }
+        cdt.initializedWithSuperTriangle();
+    }
+}
+
+#endif //STARTKIT_STRIPCDT_H
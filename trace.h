@@ -0,0 +1,125 @@
+//
+// Timeline of scoped spans per thread, written as a Chrome trace-event JSON file (open it in Perfetto or
+// chrome://tracing) for --trace. Only built in with STARTKIT_TRACE defined; otherwise TRACE_SCOPE is empty.
+//
+
+#ifndef STARTKIT_TRACE_H
+#define STARTKIT_TRACE_H
+#include <string>
+
+#ifdef STARTKIT_TRACE
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <chrono>
+#include <fstream>
+#include <cstdio>
+
+namespace trace {
+    using std::string;
+    using std::vector;
+
+    const bool compiled = true;
+
+    struct Span {
+        const char* name;
+        double start_us, duration_us;
+    };
+
+    // Each thread appends to its own buffer; the buffers are only listed under the mutex, once per thread.
+    struct Buffer {
+        int tid;
+        vector<Span> spans;
+    };
+
+    bool enabled = false;
+    const auto epoch = std::chrono::steady_clock::now();
+    std::mutex buffers_mutex;
+    vector<std::unique_ptr<Buffer>> buffers;
+
+    inline double now_us() {
+        return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - epoch).count();
+    }
+
+    Buffer& thread_buffer() {
+        thread_local Buffer* buffer = nullptr;
+        if(buffer == nullptr){
+            std::lock_guard<std::mutex> guard(buffers_mutex);
+            buffers.emplace_back(new Buffer());
+            buffer = buffers.back().get();
+            buffer->tid = (int)buffers.size();
+        }
+        return *buffer;
+    }
+
+    // The buffer is looked up when the span starts, so threads are numbered in the order they started work
+    // and the main thread, which starts first, is 1.
+    class Scope {
+    public:
+        explicit Scope(const char* name) :
+                name(name), buffer(enabled ? &thread_buffer() : nullptr), start(enabled ? now_us() : 0) {}
+
+        ~Scope() {
+            if(buffer != nullptr){
+                buffer->spans.push_back({name, start, now_us() - start});
+            }
+        }
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        const char* name;
+        Buffer* buffer;
+        double start;
+    };
+
+    // Write every span recorded so far as complete ("X") events. Call it once the worker threads are joined.
+    bool write(const string& filename) {
+        std::ofstream out(filename);
+        if(!out){
+            return false;
+        }
+        std::lock_guard<std::mutex> guard(buffers_mutex);
+        out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [";
+        bool first = true;
+        char line[256];
+        for(const auto& buffer : buffers){
+            std::snprintf(line, sizeof line,
+                          "%s\n{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %d, "
+                          "\"args\": {\"name\": \"%s %d\"}}",
+                          first ? "" : ",", buffer->tid, buffer->tid == 1 ? "main" : "worker", buffer->tid);
+            out << line;
+            first = false;
+            for(const Span& s : buffer->spans){
+                std::snprintf(line, sizeof line,
+                              ",\n{\"name\": \"%s\", \"ph\": \"X\", \"pid\": 1, \"tid\": %d, \"ts\": %.3f, \"dur\": %.3f}",
+                              s.name, buffer->tid, s.start_us, s.duration_us);
+                out << line;
+            }
+        }
+        out << "\n]}\n";
+        return true;
+    }
+}
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+#define TRACE_SCOPE(name) trace::Scope TRACE_CONCAT(trace_scope_, __LINE__)(name)
+
+#else
+
+namespace trace {
+    const bool compiled = false;
+    bool enabled = false;
+
+    inline bool write(const std::string&) {
+        return false;
+    }
+}
+
+#define TRACE_SCOPE(name) do {} while(0)
+
+#endif
+
+#endif //STARTKIT_TRACE_H